@@ -0,0 +1,61 @@
+#include <ir/arena.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef __eir__
+# define ARENA_SLAB_SIZE 0x10000
+# define ARENA_HEADER_SIZE sizeof(ArenaChunk)
+#else
+# define ARENA_SLAB_SIZE 0x100000
+# define ARENA_ALIGN 8
+# define ARENA_HEADER_SIZE \
+  ((sizeof(ArenaChunk) + ARENA_ALIGN - 1) & ~(ARENA_ALIGN - 1))
+#endif
+
+static char* arena_new_chunk(Arena* a, size_t size) {
+  ArenaChunk* c = calloc(1, ARENA_HEADER_SIZE + size);
+  c->next = a->chunks;
+  a->chunks = c;
+  return (char*)c + ARENA_HEADER_SIZE;
+}
+
+Arena* arena_new(void) {
+  return calloc(1, sizeof(Arena));
+}
+
+void* arena_alloc(Arena* a, size_t size) {
+#ifdef ARENA_ALIGN
+  size = (size + ARENA_ALIGN - 1) & ~(ARENA_ALIGN - 1);
+#endif
+  if (size > ARENA_SLAB_SIZE / 4) {
+    // Large requests get a chunk of their own so they don't waste the
+    // rest of the current slab.
+    return arena_new_chunk(a, size);
+  }
+  if ((size_t)(a->end - a->cur) < size) {
+    a->cur = arena_new_chunk(a, ARENA_SLAB_SIZE);
+    a->end = a->cur + ARENA_SLAB_SIZE;
+  }
+  char* r = a->cur;
+  a->cur += size;
+  return r;
+}
+
+char* arena_strdup(Arena* a, const char* s) {
+  size_t n = strlen(s) + 1;
+  char* r = arena_alloc(a, n);
+  memcpy(r, s, n);
+  return r;
+}
+
+void arena_free(Arena* a) {
+  if (!a)
+    return;
+  for (ArenaChunk* c = a->chunks; c;) {
+    ArenaChunk* next = c->next;
+    free(c);
+    c = next;
+  }
+  free(a);
+}
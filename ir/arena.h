@@ -0,0 +1,26 @@
+#ifndef ELVM_ARENA_H_
+#define ELVM_ARENA_H_
+
+#include <stddef.h>
+
+// A bump allocator which hands out zero-filled memory from large slabs.
+// Everything allocated from an arena is released at once by arena_free.
+typedef struct ArenaChunk_ {
+  struct ArenaChunk_* next;
+} ArenaChunk;
+
+typedef struct Arena_ {
+  ArenaChunk* chunks;
+  char* cur;
+  char* end;
+} Arena;
+
+Arena* arena_new(void);
+
+void* arena_alloc(Arena* a, size_t size);
+
+char* arena_strdup(Arena* a, const char* s);
+
+void arena_free(Arena* a);
+
+#endif  // ELVM_ARENA_H_
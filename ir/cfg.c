@@ -0,0 +1,436 @@
+#include <ir/cfg.h>
+
+#include <stdlib.h>
+
+static int cfg_value_use(Value* v) {
+  return v->type == REG ? REG_BIT(v->reg) : 0;
+}
+
+void inst_use_def(Inst* inst, int* use, int* def) {
+  *use = 0;
+  *def = 0;
+  switch (inst->op) {
+    case MOV:
+    case LOAD:
+      *use = cfg_value_use(&inst->src);
+      *def = REG_BIT(inst->dst.reg);
+      break;
+
+    case ADD:
+    case SUB:
+    case EQ:
+    case NE:
+    case LT:
+    case GT:
+    case LE:
+    case GE:
+    case MUL:
+    case DIV:
+    case MOD:
+    case AND:
+    case OR:
+    case XOR:
+    case SHL:
+    case SHR:
+      *use = REG_BIT(inst->dst.reg) | cfg_value_use(&inst->src);
+      *def = REG_BIT(inst->dst.reg);
+      break;
+
+    case STORE:
+      *use = REG_BIT(inst->dst.reg) | cfg_value_use(&inst->src);
+      break;
+
+    case PUTC:
+      *use = cfg_value_use(&inst->src);
+      break;
+
+    case GETC:
+      *def = REG_BIT(inst->dst.reg);
+      break;
+
+    case JEQ:
+    case JNE:
+    case JLT:
+    case JGT:
+    case JLE:
+    case JGE:
+      *use = REG_BIT(inst->dst.reg) | cfg_value_use(&inst->src) |
+          cfg_value_use(&inst->jmp);
+      break;
+
+    case JMP:
+      *use = cfg_value_use(&inst->jmp);
+      break;
+
+    case EXIT:
+    case DUMP:
+      break;
+
+    default:
+      break;
+  }
+}
+
+static bool cfg_is_jump(Inst* inst) {
+  return inst->op >= JEQ && inst->op <= JMP;
+}
+
+static void cfg_mark_address_taken(Cfg* cfg, bool* is_label, int v) {
+  if (v >= 0 && v < cfg->num_blocks && is_label[v])
+    cfg->blocks[v].address_taken = true;
+}
+
+static void cfg_mark_value(Cfg* cfg, bool* is_label, Value* v,
+                           bool use_labels) {
+  if (v->type != IMM)
+    return;
+  if (!use_labels || v->label == TEXT_LABEL)
+    cfg_mark_address_taken(cfg, is_label, v->imm);
+}
+
+bool has_numeric_jumps(Module* m) {
+  for (int i = 0; i < m->num_insts; i++) {
+    Inst* inst = &m->insts[i];
+    if (cfg_is_jump(inst) && inst->jmp.type == IMM &&
+        inst->jmp.label != TEXT_LABEL)
+      return true;
+  }
+  return false;
+}
+
+// State of cfg_numbers_reach. |in| holds the registers which may carry a
+// tracked number on entry to each pc, and |indirect| those at any jump
+// through a register, which may land on every labeled pc.
+typedef struct {
+  Module* m;
+  bool data;
+  bool* is_label;
+  bool* is_word;
+  int limit;
+  int* in;
+  bool* seen;
+  bool* queued;
+  int* work;
+  int num_work;
+  int indirect;
+} CfgNums;
+
+// Unlabeled numbers below |limit| are tracked.
+static bool cfg_nums_is_tracked(CfgNums* n, int v) {
+  return v >= 0 && v < n->limit;
+}
+
+static bool cfg_nums_value(CfgNums* n, Value* v, int s) {
+  if (v->type == REG)
+    return s & REG_BIT(v->reg);
+  return v->label == NO_LABEL && cfg_nums_is_tracked(n, v->imm);
+}
+
+static int cfg_nums_step(CfgNums* n, Inst* inst, int s) {
+  int d = REG_BIT(inst->dst.reg);
+  switch (inst->op) {
+    case MOV:
+      return (s & ~d) | (cfg_nums_value(n, &inst->src, s) ? d : 0);
+
+    case LOAD: {
+      int a = inst->src.imm;
+      bool word = inst->src.type == IMM && a >= 0 &&
+          a < n->m->num_data_words && n->is_word[a];
+      return (s & ~d) | (word ? d : 0);
+    }
+
+    case ADD:
+    case SUB:
+    case MUL:
+    case DIV:
+    case MOD:
+    case AND:
+    case OR:
+    case XOR:
+    case SHL:
+    case SHR:
+      // Offsets keep a number tracked but do not make a base address one.
+      if (inst->src.type == REG && (s & REG_BIT(inst->src.reg)))
+        return s | d;
+      return s;
+
+    case GETC:
+    case EQ:
+    case NE:
+    case LT:
+    case GT:
+    case LE:
+    case GE:
+      return s & ~d;
+
+    default:
+      return s;
+  }
+}
+
+static bool cfg_nums_sink(CfgNums* n, Inst* inst, int s) {
+  if (n->data) {
+    return (inst->op == LOAD || inst->op == STORE) &&
+        cfg_nums_value(n, &inst->src, s);
+  }
+  return cfg_is_jump(inst) && inst->jmp.type == REG &&
+      (s & REG_BIT(inst->jmp.reg));
+}
+
+static void cfg_nums_push(CfgNums* n, int pc) {
+  if (n->queued[pc])
+    return;
+  n->queued[pc] = true;
+  n->work[n->num_work++] = pc;
+}
+
+static void cfg_nums_flow(CfgNums* n, int pc, int s) {
+  if (pc < 0 || pc >= n->m->num_blocks)
+    return;
+  if (n->seen[pc] && (n->in[pc] | s) == n->in[pc])
+    return;
+  n->seen[pc] = true;
+  n->in[pc] |= s;
+  cfg_nums_push(n, pc);
+}
+
+// Whether a tracked number may reach a sink: a jump through a register,
+// or the address of a load or store if |data|. Numbers are followed
+// through registers from pc 0 and every labeled pc. A number spilled to
+// memory and loaded back is not, except data words read from constant
+// addresses.
+static bool cfg_numbers_reach(Module* m, bool data) {
+  CfgNums n = {};
+  n.m = m;
+  n.data = data;
+  n.limit = data ? m->num_data_words : m->num_blocks;
+  n.is_label = calloc(m->num_blocks + 1, sizeof(bool));
+  for (Sym* sym = m->syms; sym; sym = sym->next) {
+    if (sym->is_text && sym->value < m->num_blocks)
+      n.is_label[sym->value] = true;
+  }
+  n.is_word = calloc(m->num_data_words + 1, sizeof(bool));
+  int i = 0;
+  for (Data* d = m->data; d; d = d->next, i++)
+    n.is_word[i] = d->label == NO_LABEL && cfg_nums_is_tracked(&n, d->v);
+  n.in = calloc(m->num_blocks + 1, sizeof(int));
+  n.seen = calloc(m->num_blocks + 1, sizeof(bool));
+  n.queued = calloc(m->num_blocks + 1, sizeof(bool));
+  n.work = malloc(sizeof(int) * (m->num_blocks + 1));
+
+  cfg_nums_flow(&n, 0, 0);
+  for (int pc = 0; pc < m->num_blocks; pc++) {
+    if (n.is_label[pc])
+      cfg_nums_flow(&n, pc, 0);
+  }
+  bool found = false;
+  while (n.num_work && !found) {
+    int pc = n.work[--n.num_work];
+    n.queued[pc] = false;
+    int s = n.in[pc] | (n.is_label[pc] ? n.indirect : 0);
+    BasicBlock* bb = &m->blocks[pc];
+    bool falls = true;
+    for (i = bb->start; i < bb->start + bb->len; i++) {
+      Inst* inst = &m->insts[i];
+      if (cfg_nums_sink(&n, inst, s)) {
+        found = true;
+        break;
+      }
+      if (cfg_is_jump(inst)) {
+        if (inst->jmp.type == IMM) {
+          cfg_nums_flow(&n, inst->jmp.imm, s);
+        } else if ((n.indirect | s) != n.indirect) {
+          n.indirect |= s;
+          for (int l = 0; l < m->num_blocks; l++) {
+            if (n.is_label[l])
+              cfg_nums_push(&n, l);
+          }
+        }
+        if (inst->op == JMP) {
+          falls = false;
+          break;
+        }
+      }
+      if (inst->op == EXIT) {
+        falls = false;
+        break;
+      }
+      s = cfg_nums_step(&n, inst, s);
+    }
+    if (falls && !found)
+      cfg_nums_flow(&n, pc + 1, s);
+  }
+
+  free(n.is_label);
+  free(n.is_word);
+  free(n.in);
+  free(n.seen);
+  free(n.queued);
+  free(n.work);
+  return found;
+}
+
+bool has_numeric_code_addrs(Module* m) {
+  return has_numeric_jumps(m) || cfg_numbers_reach(m, false);
+}
+
+bool has_numeric_data_addrs(Module* m) {
+  return cfg_numbers_reach(m, true);
+}
+
+static void cfg_find_address_taken(Cfg* cfg) {
+  Module* m = cfg->module;
+  bool* is_label = calloc(cfg->num_blocks + 1, sizeof(bool));
+  for (Sym* sym = m->syms; sym; sym = sym->next) {
+    if (sym->is_text && sym->value < cfg->num_blocks)
+      is_label[sym->value] = true;
+  }
+
+  bool use_labels = !has_numeric_code_addrs(m);
+  int i = 0;
+  for (Data* d = m->data; d; d = d->next, i++) {
+    if (!use_labels || d->label == TEXT_LABEL)
+      cfg_mark_address_taken(cfg, is_label, m->data_words[i]);
+  }
+  for (i = 0; i < m->num_insts; i++) {
+    Inst* inst = &m->insts[i];
+    cfg_mark_value(cfg, is_label, &inst->src, use_labels);
+    cfg_mark_value(cfg, is_label, &inst->dst, use_labels);
+  }
+  free(is_label);
+
+  int n = 0;
+  for (int pc = 0; pc < cfg->num_blocks; pc++) {
+    if (cfg->blocks[pc].address_taken)
+      n++;
+  }
+  cfg->address_taken = calloc(n + 1, sizeof(int));
+  cfg->num_address_taken = n;
+  n = 0;
+  for (int pc = 0; pc < cfg->num_blocks; pc++) {
+    if (cfg->blocks[pc].address_taken)
+      cfg->address_taken[n++] = pc;
+  }
+}
+
+static void cfg_add_succ(CfgBlock* b, int pc, int num_blocks) {
+  if (pc < 0 || pc >= num_blocks)
+    return;
+  if (b->num_succs && b->succs[0] == pc)
+    return;
+  b->succs[b->num_succs++] = pc;
+}
+
+static void cfg_build_block(Cfg* cfg, int pc) {
+  Module* m = cfg->module;
+  BasicBlock* bb = &m->blocks[pc];
+  CfgBlock* b = &cfg->blocks[pc];
+  bool falls_through = true;
+  for (int i = bb->start; i < bb->start + bb->len; i++) {
+    Inst* inst = &m->insts[i];
+    int use, def;
+    inst_use_def(inst, &use, &def);
+    b->use |= use & ~b->def;
+    b->def |= def;
+
+    if (inst->op == EXIT) {
+      falls_through = false;
+      break;
+    }
+    if (cfg_is_jump(inst)) {
+      if (inst->jmp.type == REG)
+        b->indirect = true;
+      else
+        cfg_add_succ(b, inst->jmp.imm, cfg->num_blocks);
+      if (inst->op == JMP) {
+        falls_through = false;
+        break;
+      }
+    }
+  }
+  if (falls_through)
+    cfg_add_succ(b, pc + 1, cfg->num_blocks);
+}
+
+static void cfg_build_preds(Cfg* cfg) {
+  for (int pc = 0; pc < cfg->num_blocks; pc++) {
+    CfgBlock* b = &cfg->blocks[pc];
+    for (int i = 0; i < b->num_succs; i++)
+      cfg->blocks[b->succs[i]].num_preds++;
+  }
+  for (int pc = 0; pc < cfg->num_blocks; pc++) {
+    CfgBlock* b = &cfg->blocks[pc];
+    b->preds = calloc(b->num_preds + 1, sizeof(int));
+    b->num_preds = 0;
+  }
+  for (int pc = 0; pc < cfg->num_blocks; pc++) {
+    CfgBlock* b = &cfg->blocks[pc];
+    for (int i = 0; i < b->num_succs; i++) {
+      CfgBlock* s = &cfg->blocks[b->succs[i]];
+      s->preds[s->num_preds++] = pc;
+    }
+  }
+}
+
+static void cfg_compute_liveness(Cfg* cfg) {
+  bool changed = true;
+  while (changed) {
+    changed = false;
+    int indirect_in = 0;
+    for (int i = 0; i < cfg->num_address_taken; i++)
+      indirect_in |= cfg->blocks[cfg->address_taken[i]].live_in;
+
+    for (int pc = cfg->num_blocks - 1; pc >= 0; pc--) {
+      CfgBlock* b = &cfg->blocks[pc];
+      int out = b->indirect ? indirect_in : 0;
+      for (int i = 0; i < b->num_succs; i++)
+        out |= cfg->blocks[b->succs[i]].live_in;
+      int in = b->use | (out & ~b->def);
+      if (out != b->live_out || in != b->live_in) {
+        b->live_out = out;
+        b->live_in = in;
+        changed = true;
+      }
+    }
+  }
+}
+
+Cfg* build_cfg(Module* m) {
+  Cfg* cfg = calloc(1, sizeof(Cfg));
+  cfg->module = m;
+  cfg->num_blocks = m->num_blocks;
+  cfg->blocks = calloc(cfg->num_blocks + 1, sizeof(CfgBlock));
+  cfg_find_address_taken(cfg);
+  for (int pc = 0; pc < cfg->num_blocks; pc++)
+    cfg_build_block(cfg, pc);
+  cfg_build_preds(cfg);
+  cfg_compute_liveness(cfg);
+  return cfg;
+}
+
+void free_cfg(Cfg* cfg) {
+  for (int pc = 0; pc < cfg->num_blocks; pc++)
+    free(cfg->blocks[pc].preds);
+  free(cfg->blocks);
+  free(cfg->address_taken);
+  free(cfg);
+}
+
+int live_after_inst(Cfg* cfg, int pc, Inst* inst) {
+  Module* m = cfg->module;
+  BasicBlock* bb = &m->blocks[pc];
+  int live = cfg->blocks[pc].live_out;
+  for (int i = bb->start + bb->len - 1; i >= bb->start; i--) {
+    Inst* cur = &m->insts[i];
+    if (cur == inst)
+      return live;
+    if (cur->op == EXIT) {
+      live = 0;
+      continue;
+    }
+    int use, def;
+    inst_use_def(cur, &use, &def);
+    live = use | (live & ~def);
+  }
+  return live;
+}
@@ -0,0 +1,73 @@
+#ifndef ELVM_CFG_H_
+#define ELVM_CFG_H_
+
+#include <stdbool.h>
+
+#include <ir/ir.h>
+
+#define REG_BIT(r) (1 << (r))
+#define ALL_REGS ((1 << 6) - 1)
+
+// A node of the control flow graph, one per pc. |succs| and |preds| hold
+// direct edges only. A block which jumps through a register is marked
+// |indirect| and may also reach every |address_taken| block.
+//
+// Register sets are bitmasks of REG_BIT(reg).
+typedef struct {
+  int succs[2];
+  int num_succs;
+  int* preds;
+  int num_preds;
+  bool indirect;
+  bool address_taken;
+  int use;
+  int def;
+  int live_in;
+  int live_out;
+} CfgBlock;
+
+typedef struct {
+  Module* module;
+  CfgBlock* blocks;
+  int num_blocks;
+  // Sorted pcs which may be reached by a jump through a register.
+  int* address_taken;
+  int num_address_taken;
+} Cfg;
+
+// Builds the CFG of |m| and computes per-block register liveness. The
+// module must be indexed (see index_module).
+//
+// A pc counts as address-taken when a text label of it is used as an
+// immediate outside a jump target or as a data word. This
+// over-approximates the code addresses that reach register jumps, since
+// they may flow through memory. Hand-written modules may compute
+// addresses from plain numbers as well (see has_numeric_code_addrs), so
+// for them any immediate or data word equal to a labeled pc counts.
+Cfg* build_cfg(Module* m);
+
+void free_cfg(Cfg* cfg);
+
+// Whether |m| has a jump to an immediate which is not a text label.
+bool has_numeric_jumps(Module* m);
+
+// Whether code addresses in |m| may come from plain numbers rather than
+// text labels: a jump goes to a numeric pc, or an unlabeled number below
+// the number of pcs may reach a jump through a register. Numbers are
+// followed through registers and data words loaded from constant
+// addresses only, so code addresses kept in memory have to be text
+// labels. Passes which renumber or retarget blocks must leave modules
+// with numeric code addresses alone.
+bool has_numeric_code_addrs(Module* m);
+
+// Likewise, whether an unlabeled number below the size of the data
+// segment may be the address of a load or store.
+bool has_numeric_data_addrs(Module* m);
+
+// Registers read and written by |inst|.
+void inst_use_def(Inst* inst, int* use, int* def);
+
+// Registers live right after |inst|, which must be in block |pc|.
+int live_after_inst(Cfg* cfg, int pc, Inst* inst);
+
+#endif  // ELVM_CFG_H_
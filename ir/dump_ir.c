@@ -1,21 +1,76 @@
+#include <stdbool.h>
 #include <stdlib.h>
+#include <string.h>
 
+#include <ir/cfg.h>
 #include <ir/ir.h>
 
+static void dump_regs_mask(const char* name, int regs) {
+  static const char* REG_NAMES[] = {
+    "A", "B", "C", "D", "BP", "SP"
+  };
+  fprintf(stderr, " %s=", name);
+  bool first = true;
+  for (int r = 0; r < 6; r++) {
+    if (regs & REG_BIT(r)) {
+      fprintf(stderr, first ? "%s" : ",%s", REG_NAMES[r]);
+      first = false;
+    }
+  }
+}
+
+static void dump_cfg(Module* m) {
+  Cfg* cfg = build_cfg(m);
+  for (int pc = 0; pc < cfg->num_blocks; pc++) {
+    CfgBlock* b = &cfg->blocks[pc];
+    fprintf(stderr, "block %d:", pc);
+    if (b->address_taken)
+      fprintf(stderr, " address_taken");
+    if (b->indirect)
+      fprintf(stderr, " indirect");
+    fprintf(stderr, " succs=");
+    for (int i = 0; i < b->num_succs; i++)
+      fprintf(stderr, i ? ",%d" : "%d", b->succs[i]);
+    fprintf(stderr, " preds=");
+    for (int i = 0; i < b->num_preds; i++)
+      fprintf(stderr, i ? ",%d" : "%d", b->preds[i]);
+    dump_regs_mask("live_in", b->live_in);
+    dump_regs_mask("live_out", b->live_out);
+    fprintf(stderr, "\n");
+    BasicBlock* bb = &m->blocks[pc];
+    for (int i = bb->start; i < bb->start + bb->len; i++) {
+      fprintf(stderr, "  ");
+      dump_inst(&m->insts[i]);
+    }
+  }
+  free_cfg(cfg);
+}
+
 int main(int argc, char* argv[]) {
+  bool cfg = false;
 #if defined(NOFILE) || defined(__eir__)
   Module* m = load_eir(stdin);
   // Host dump_ir.c.exe should dump to stdout for testing.
   stderr = stdout;
 #else
+  if (argc >= 2 && !strcmp(argv[1], "-cfg")) {
+    cfg = true;
+    argc--;
+    argv++;
+  }
   if (argc < 2) {
     fprintf(stderr, "no input file\n");
     exit(1);
   }
   Module* m = load_eir_from_file(argv[1]);
 #endif
-  for (Inst* inst = m->text; inst; inst = inst->next) {
-    dump_inst(inst);
+  if (cfg) {
+    dump_cfg(m);
+  } else {
+    for (Inst* inst = m->text; inst; inst = inst->next) {
+      dump_inst(inst);
+    }
   }
+  free_module(m);
   return 0;
 }
@@ -0,0 +1,33 @@
+#ifndef ELVM_EIRB_H_
+#define ELVM_EIRB_H_
+
+// Binary EIR, written by `elc -eirb` and read by load_eir_binary.
+// Symbols are already resolved, so loading it needs neither lexing nor
+// symbol lookups. Every field is a little-endian 32bit word:
+//
+//   header:  magic version num_insts num_data num_syms num_files
+//            num_locs num_magics
+//   files:   num_files strings, the file names of .file directives
+//   locs:    num_locs pairs of line and file, where file is 0 or a
+//            1-based index into files
+//   text:    num_insts records of op types dst src jmp pc lineno+1 loc,
+//            where bits 0, 1 and 2 of types are the ValueType of dst,
+//            src and jmp, and bits 3-4, 5-6 and 7-8 their LabelKind,
+//            and loc is 0 or a 1-based index into locs
+//   data:    num_data pairs of value and LabelKind for the data segment,
+//            ending with the word _edata points to
+//   symbols: num_syms records of value is_text and a string for the name
+//   magics:  num_magics pairs of an instruction index and a string for
+//            its magic comment, in text order
+//
+// A string is its length followed by its bytes and a NUL, padded to a
+// word boundary. Line numbers are stored biased by one so the
+// synthesized jump to main (lineno -1) doesn't depend on the width of
+// int.
+
+#define EIRB_MAGIC "EIRB"
+#define EIRB_VERSION 3
+#define EIRB_HEADER_WORDS 8
+#define EIRB_INST_WORDS 8
+
+#endif  // ELVM_EIRB_H_
@@ -3,8 +3,20 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#ifndef __eir__
+#include <dirent.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 
 #include <ir/ir.h>
+#include <ir/jit.h>
+#include <ir/libeli.h>
+#include <ir/table.h>
 
 #ifdef __eir__
 #define MEMSZ 0x100000
@@ -12,9 +24,16 @@
 #define MEMSZ 0x1000000
 #endif
 
+// Words wrap at the memory size, which is a power of two.
+#define WORD_MASK (MEMSZ - 1)
+
 int pc;
-Inst* prog[65536];
+#ifdef __eir__
 int mem[MEMSZ];
+#else
+// Mapped by eli_init_mem, so pages are only committed once touched.
+int* mem;
+#endif
 int regs[6];
 bool verbose;
 
@@ -26,6 +45,59 @@ static void error(const char* msg) {
   exit(1);
 }
 
+#ifdef __eir__
+#define eli_putc(c) putchar(c)
+#define eli_getc() getchar()
+#else
+#define IO_BUFSZ (1 << 16)
+
+static bool eli_tty_input;
+
+// Unless |unbuffered|, stdin is read and stdout is written in large
+// blocks. Output is then flushed when the buffer fills, at exit, and
+// before reading from a terminal.
+static void eli_init_io(bool unbuffered) {
+  static char in_buf[IO_BUFSZ];
+  static char out_buf[IO_BUFSZ];
+  if (unbuffered) {
+    setvbuf(stdin, NULL, _IONBF, 0);
+    setvbuf(stdout, NULL, _IONBF, 0);
+  } else {
+    setvbuf(stdin, in_buf, _IOFBF, IO_BUFSZ);
+    setvbuf(stdout, out_buf, _IOFBF, IO_BUFSZ);
+    eli_tty_input = isatty(0);
+  }
+}
+
+static void eli_init_mem(void) {
+  int flags = MAP_PRIVATE | MAP_ANONYMOUS;
+#ifdef MAP_NORESERVE
+  flags |= MAP_NORESERVE;
+#endif
+  mem = mmap(NULL, sizeof(int) * MEMSZ, PROT_READ | PROT_WRITE, flags, -1, 0);
+  if (mem == MAP_FAILED) {
+    perror("mmap");
+    exit(1);
+  }
+}
+
+static void eli_report_rss(void) {
+  struct rusage ru;
+  if (!getrusage(RUSAGE_SELF, &ru))
+    fprintf(stderr, "peak RSS: %ld KiB\n", ru.ru_maxrss);
+}
+
+static void eli_putc(int c) {
+  putc_unlocked(c, stdout);
+}
+
+static int eli_getc(void) {
+  if (eli_tty_input)
+    fflush(stdout);
+  return getc_unlocked(stdin);
+}
+#endif
+
 static inline void dump_regs(Inst* inst) {
   bool had_negative = false;
   static const char* REG_NAMES[] = {
@@ -84,39 +156,293 @@ static int cmp(Inst* inst) {
   }
 }
 
-int main(int argc, char* argv[]) {
-#if defined(NOFILE) || defined(__eir__)
-  Module* m = load_eir(stdin);
-#else
-  if (argc >= 2 && !strcmp(argv[1], "-v")) {
-    verbose = true;
-    argc--;
-    argv++;
+#ifndef __eir__
+// With -profile, the reference interpreter counts executions of each
+// instruction. At exit, the hottest blocks are reported to stderr and
+// all executed blocks are written as JSON to |eli_profile_path|.
+typedef struct {
+  int pc;
+  long entries;
+  long insts;
+} EliBlockProfile;
+
+static Module* eli_profile_module;
+static long* eli_counts;
+static const char* eli_profile_path;
+
+static int eli_cmp_block_profile(const void* a, const void* b) {
+  const EliBlockProfile* x = a;
+  const EliBlockProfile* y = b;
+  if (x->insts != y->insts)
+    return x->insts < y->insts ? 1 : -1;
+  return x->pc - y->pc;
+}
+
+// Fills |op_counts| with the executions of each op in block |pc|.
+static void eli_block_ops(int pc, long* op_counts) {
+  Module* m = eli_profile_module;
+  BasicBlock* bb = &m->blocks[pc];
+  memset(op_counts, 0, sizeof(long) * LAST_OP);
+  for (int i = bb->start; i < bb->start + bb->len; i++)
+    op_counts[m->insts[i].op] += eli_counts[i];
+}
+
+static void eli_json_string(const char* s, FILE* fp) {
+  fputc('"', fp);
+  for (; *s; s++) {
+    if (*s == '"' || *s == '\\')
+      fputc('\\', fp);
+    fputc(*s, fp);
   }
+  fputc('"', fp);
+}
 
-  if (argc < 2) {
-    fprintf(stderr, "no input file\n");
-    return 1;
+static void eli_write_profile_json(EliBlockProfile* blocks, int n,
+                                   long total, const char** labels) {
+  Module* m = eli_profile_module;
+  FILE* fp = fopen(eli_profile_path, "w");
+  if (!fp) {
+    perror(eli_profile_path);
+    return;
+  }
+  long op_counts[LAST_OP];
+  fprintf(fp, "{\"total\": %ld, \"blocks\": [", total);
+  for (int i = 0; i < n; i++) {
+    EliBlockProfile* b = &blocks[i];
+    BasicBlock* bb = &m->blocks[b->pc];
+    fprintf(fp, "%s\n  {\"pc\": %d, \"label\": ", i ? "," : "", b->pc);
+    if (labels[b->pc])
+      eli_json_string(labels[b->pc], fp);
+    else
+      fprintf(fp, "null");
+    fprintf(fp, ", \"entries\": %ld, \"insts\": %ld, \"ops\": {",
+            b->entries, b->insts);
+    eli_block_ops(b->pc, op_counts);
+    bool first = true;
+    for (int op = 0; op < LAST_OP; op++) {
+      if (!op_counts[op])
+        continue;
+      fprintf(fp, "%s\"", first ? "" : ", ");
+      dump_op(op, fp);
+      fprintf(fp, "\": %ld", op_counts[op]);
+      first = false;
+    }
+    fprintf(fp, "}, \"lines\": [");
+    for (int j = 0; j < bb->len; j++)
+      fprintf(fp, "%s%d", j ? ", " : "", m->insts[bb->start + j].lineno);
+    fprintf(fp, "], \"counts\": [");
+    for (int j = 0; j < bb->len; j++)
+      fprintf(fp, "%s%ld", j ? ", " : "", eli_counts[bb->start + j]);
+    fprintf(fp, "]}");
+  }
+  fprintf(fp, "\n]}\n");
+  fclose(fp);
+}
+
+static void eli_report_profile(void) {
+  Module* m = eli_profile_module;
+  const char** labels = calloc(m->num_blocks, sizeof(*labels));
+  for (Sym* s = m->syms; s; s = s->next) {
+    if (s->is_text && s->value >= 0 && s->value < m->num_blocks &&
+        !labels[s->value])
+      labels[s->value] = s->name;
+  }
+  // Blocks without a label of their own are named after the closest
+  // labelled block before them, e.g. "loop+2".
+  int labelled = -1;
+  for (int pc = 0; pc < m->num_blocks; pc++) {
+    if (labels[pc]) {
+      labelled = pc;
+    } else if (labelled >= 0) {
+      const char* base = labels[labelled];
+      char* name = malloc(strlen(base) + 16);
+      sprintf(name, "%s+%d", base, pc - labelled);
+      labels[pc] = name;
+    }
   }
 
-  Module* m = load_eir_from_file(argv[1]);
-#endif
+  EliBlockProfile* blocks = calloc(m->num_blocks, sizeof(*blocks));
+  int n = 0;
+  long total = 0;
+  for (int pc = 0; pc < m->num_blocks; pc++) {
+    BasicBlock* bb = &m->blocks[pc];
+    if (!bb->len || !eli_counts[bb->start])
+      continue;
+    EliBlockProfile* b = &blocks[n++];
+    b->pc = pc;
+    b->entries = eli_counts[bb->start];
+    for (int i = bb->start; i < bb->start + bb->len; i++)
+      b->insts += eli_counts[i];
+    total += b->insts;
+  }
+  qsort(blocks, n, sizeof(*blocks), eli_cmp_block_profile);
 
-  int i;
-  i = 0;
-  for (Data* d = m->data; d; d = d->next, i++) {
-    mem[i] = d->v;
+  fprintf(stderr, "profile: %ld insts in %d blocks\n", total, n);
+  fprintf(stderr, "%8s %-20s %12s %12s %6s  %s\n",
+          "pc", "label", "entries", "insts", "%", "ops");
+  long op_counts[LAST_OP];
+  for (int i = 0; i < n && i < 20; i++) {
+    EliBlockProfile* b = &blocks[i];
+    fprintf(stderr, "%8d %-20s %12ld %12ld %5.1f%% ",
+            b->pc, labels[b->pc] ? labels[b->pc] : "-", b->entries,
+            b->insts, 100.0 * b->insts / total);
+    // The four most frequent ops of the block.
+    eli_block_ops(b->pc, op_counts);
+    for (int k = 0; k < 4; k++) {
+      int best = -1;
+      for (int op = 0; op < LAST_OP; op++) {
+        if (op_counts[op] && (best < 0 || op_counts[op] > op_counts[best]))
+          best = op;
+      }
+      if (best < 0)
+        break;
+      fprintf(stderr, " ");
+      dump_op(best, stderr);
+      fprintf(stderr, ":%ld", op_counts[best]);
+      op_counts[best] = 0;
+    }
+    fprintf(stderr, "\n");
   }
-  for (Inst* inst = m->text; inst; i++) {
-    pc = inst->pc;
-    prog[pc] = inst;
-    for (; inst && pc == inst->pc; inst = inst->next) {}
+
+  eli_write_profile_json(blocks, n, total, labels);
+  fprintf(stderr, "profile written to %s\n", eli_profile_path);
+  free(blocks);
+  free(labels);
+}
+
+// With -cprofile, the reference interpreter samples the C call stack
+// every ELI_SAMPLE_PERIOD instructions, following the frame chain of
+// 8cc's calling convention: mem[BP] is the caller's BP and mem[BP+1]
+// the return address. Samples are written to |eli_stacks_path| in the
+// collapsed format of flamegraph.pl, leaf frames ending with the C
+// line from .loc.
+#define ELI_SAMPLE_PERIOD 64
+#define ELI_MAX_FRAMES 256
+
+static int eli_sample_countdown;
+static const char** eli_funcs;
+static Table* eli_stacks;
+static Table* eli_leaves;
+static const char* eli_stacks_path;
+
+// Names each pc after the closest non-local text label before it.
+static void eli_init_funcs(Module* m) {
+  eli_funcs = calloc(m->num_blocks, sizeof(*eli_funcs));
+  for (Sym* s = m->syms; s; s = s->next) {
+    if (s->is_text && s->name[0] != '.' &&
+        s->value >= 0 && s->value < m->num_blocks)
+      eli_funcs[s->value] = s->name;
   }
+  const char* func = "?";
+  for (int pc = 0; pc < m->num_blocks; pc++) {
+    if (eli_funcs[pc])
+      func = eli_funcs[pc];
+    eli_funcs[pc] = func;
+  }
+}
+
+static void eli_count_sample(Table** tbl, const char* key) {
+  long* count;
+  if (!table_get(*tbl, key, (const void**)&count)) {
+    count = calloc(1, sizeof(long));
+    *tbl = table_add(*tbl, strdup(key), count);
+  }
+  ++*count;
+}
 
+static void eli_sample_stack(Module* m, Inst* inst) {
+  const char* frames[ELI_MAX_FRAMES];
+  int n = 0;
+  frames[n++] = eli_funcs[inst->pc];
+  for (int bp = regs[BP]; n < ELI_MAX_FRAMES && bp > 0 && bp + 1 < MEMSZ;) {
+    int ret = mem[bp + 1];
+    if (ret < 0 || ret >= m->num_blocks)
+      break;
+    frames[n++] = eli_funcs[ret];
+    // Frames of callers are at higher addresses.
+    if (mem[bp] <= bp)
+      break;
+    bp = mem[bp];
+  }
+
+  char buf[4096];
+  char* p = buf;
+  char* end = buf + sizeof(buf) - 64;
+  for (int i = n - 1; i >= 0 && p + strlen(frames[i]) < end; i--)
+    p += sprintf(p, "%s%s", i == n - 1 ? "" : ";", frames[i]);
+  char leaf[128];
+  if (inst->loc) {
+    const char* file = inst->loc->file ? inst->loc->file : "?";
+    sprintf(p, ";%.32s:%d", file, inst->loc->line);
+    sprintf(leaf, "%.48s (%.32s:%d)", frames[0], file, inst->loc->line);
+  } else {
+    sprintf(leaf, "%.48s", frames[0]);
+  }
+  eli_count_sample(&eli_stacks, buf);
+  eli_count_sample(&eli_leaves, leaf);
+}
+
+static int eli_cmp_samples(const void* a, const void* b) {
+  long x = *(long*)((TableEntry*)a)->value;
+  long y = *(long*)((TableEntry*)b)->value;
+  return x < y ? 1 : x > y ? -1 : 0;
+}
+
+static void eli_report_cprofile(void) {
+  FILE* fp = fopen(eli_stacks_path, "w");
+  if (!fp) {
+    perror(eli_stacks_path);
+    return;
+  }
+  long total = 0;
+  for (int i = 0; eli_stacks && i < eli_stacks->cap; i++) {
+    TableEntry* e = &eli_stacks->entries[i];
+    if (e->key) {
+      fprintf(fp, "%s %ld\n", e->key, *(long*)e->value);
+      total += *(long*)e->value;
+    }
+  }
+  fclose(fp);
+
+  // Samples by function and line, hottest first.
+  int n = eli_leaves ? eli_leaves->size : 0;
+  TableEntry* sorted = calloc(n + 1, sizeof(TableEntry));
+  n = 0;
+  for (int i = 0; eli_leaves && i < eli_leaves->cap; i++) {
+    if (eli_leaves->entries[i].key)
+      sorted[n++] = eli_leaves->entries[i];
+  }
+  qsort(sorted, n, sizeof(*sorted), eli_cmp_samples);
+  fprintf(stderr, "cprofile: %ld samples, 1 per %d insts\n",
+          total, ELI_SAMPLE_PERIOD);
+  for (int i = 0; i < n && i < 20; i++) {
+    long count = *(long*)sorted[i].value;
+    fprintf(stderr, "%10ld %5.1f%%  %s\n",
+            count, 100.0 * count / total, sorted[i].key);
+  }
+  fprintf(stderr, "stacks written to %s\n", eli_stacks_path);
+  free(sorted);
+}
+#endif
+
+// The reference interpreter, which walks the instruction list.
+static void run_slow(Module* m) {
   pc = m->text->pc;
   for (;;) {
-    Inst* inst = prog[pc];
+    if (pc < 0 || pc >= m->num_blocks ||
+        m->blocks[pc].start == m->num_insts) {
+      error("jump to outside of text");
+    }
+    Inst* inst = &m->insts[m->blocks[pc].start];
     for (; inst; inst = inst->next) {
+#ifndef __eir__
+      if (eli_counts)
+        eli_counts[inst - m->insts]++;
+      if (eli_sample_countdown && !--eli_sample_countdown) {
+        eli_sample_countdown = ELI_SAMPLE_PERIOD;
+        eli_sample_stack(m, inst);
+      }
+#endif
       if (verbose) {
         dump_regs(inst);
         dump_inst(inst);
@@ -131,15 +457,13 @@ int main(int argc, char* argv[]) {
         case ADD:
           assert(inst->dst.type == REG);
           regs[inst->dst.reg] += src(inst);
-          regs[inst->dst.reg] += MEMSZ;
-          regs[inst->dst.reg] %= MEMSZ;
+          regs[inst->dst.reg] &= WORD_MASK;
           break;
 
         case SUB:
           assert(inst->dst.type == REG);
           regs[inst->dst.reg] -= src(inst);
-          regs[inst->dst.reg] += MEMSZ;
-          regs[inst->dst.reg] %= MEMSZ;
+          regs[inst->dst.reg] &= WORD_MASK;
           break;
 
         case LOAD: {
@@ -161,14 +485,12 @@ int main(int argc, char* argv[]) {
         }
 
         case PUTC:
-          putchar(src(inst));
+          eli_putc(src(inst));
           break;
 
         case GETC: {
-          int c = getchar();
-          regs[inst->dst.reg] = c == EOF ? 0 : c;
-          regs[inst->dst.reg] += MEMSZ;
-          regs[inst->dst.reg] %= MEMSZ;
+          int c = eli_getc();
+          regs[inst->dst.reg] = (c == EOF ? 0 : c) & WORD_MASK;
           break;
         }
 
@@ -187,6 +509,18 @@ int main(int argc, char* argv[]) {
           regs[inst->dst.reg] = cmp(inst);
           break;
 
+        case MUL:
+        case DIV:
+        case MOD:
+        case AND:
+        case OR:
+        case XOR:
+        case SHL:
+        case SHR:
+          regs[inst->dst.reg] =
+              eval_ext_op(inst->op, regs[inst->dst.reg], src(inst));
+          break;
+
         case JEQ:
         case JNE:
         case JLT:
@@ -209,6 +543,324 @@ int main(int argc, char* argv[]) {
       }
     }
   }
+}
+
+#ifdef ELVM_HAS_LIBELI
+
+// Reads one byte at a time, so a program never waits for more input
+// than it asked for.
+static int eli_cli_read(void* ctx, char* buf, int cap) {
+  (void)ctx;
+  int c = eli_getc();
+  if (c == EOF || cap < 1)
+    return 0;
+  buf[0] = c;
+  return 1;
+}
+
+static void eli_cli_write(void* ctx, const char* buf, int len) {
+  fwrite(buf, 1, len, ctx);
+}
+
+// The default engine runs the module through libeli, with its output
+// flushed at least as often as the CLI would flush it.
+__attribute__((noreturn))
+static void run_libeli(Module* m, bool unbuffered, bool stats) {
+  EliModule* em = eli_module_new(m, stats);
+  EliInstance* inst = eli_instance_new(em);
+  EliIO io = { eli_cli_read, eli_cli_write, stdout, unbuffered ? 1 : 4096 };
+  if (eli_run_io(inst, &io) == ELI_ERROR) {
+    fflush(stdout);
+    fprintf(stderr, "%s\n", eli_error(inst));
+    exit(1);
+  }
+  if (stats)
+    eli_report_stats(em);
+  exit(0);
+}
+
+// Runs a module once per input file, writing <input>.out for each, or
+// <outdir>/<basename>.out with an |outdir|. Each of |jobs| threads has
+// its own instance of the module, which it resets between inputs.
+typedef struct {
+  EliModule* em;
+  char** inputs;
+  int num_inputs;
+  const char* outdir;
+  int next;
+  int status;
+} EliBatch;
+
+static char* eli_read_file(const char* path, size_t* len) {
+  FILE* fp = fopen(path, "rb");
+  if (!fp)
+    return NULL;
+  char* data = NULL;
+  size_t cap = 0;
+  size_t n;
+  *len = 0;
+  do {
+    if (*len == cap) {
+      cap = cap * 2 + 4096;
+      data = realloc(data, cap);
+    }
+    n = fread(data + *len, 1, cap - *len, fp);
+    *len += n;
+  } while (n);
+  fclose(fp);
+  return data;
+}
+
+static int eli_run_input(EliInstance* inst, const char* input,
+                         const char* outdir, EliBuffer* out) {
+  int status = 0;
+  size_t len;
+  char* data = eli_read_file(input, &len);
+  if (!data) {
+    perror(input);
+    return 1;
+  }
+  out->len = 0;
+  if (eli_run(inst, data, len, out) == ELI_ERROR) {
+    fprintf(stderr, "%s: %s\n", input, eli_error(inst));
+    status = 1;
+  }
+  free(data);
+  eli_reset(inst);
+
+  const char* base = input;
+  if (outdir) {
+    const char* p = strrchr(input, '/');
+    base = p ? p + 1 : input;
+  }
+  char* path = malloc((outdir ? strlen(outdir) + 1 : 0) + strlen(base) + 5);
+  sprintf(path, "%s%s%s.out", outdir ? outdir : "", outdir ? "/" : "", base);
+  FILE* fp = fopen(path, "wb");
+  if (!fp || fwrite(out->data, 1, out->len, fp) != out->len) {
+    perror(path);
+    status = 1;
+  }
+  if (fp && fclose(fp)) {
+    perror(path);
+    status = 1;
+  }
+  free(path);
+  return status;
+}
+
+static void* eli_batch_worker(void* arg) {
+  EliBatch* b = arg;
+  EliInstance* inst = eli_instance_new(b->em);
+  EliBuffer out = {};
+  int i;
+  while ((i = __sync_fetch_and_add(&b->next, 1)) < b->num_inputs) {
+    if (eli_run_input(inst, b->inputs[i], b->outdir, &out))
+      __sync_fetch_and_or(&b->status, 1);
+  }
+  free(out.data);
+  eli_instance_free(inst);
+  return NULL;
+}
+
+static int run_batch(const char* filename, int num_inputs, char** inputs,
+                     const char* outdir, int jobs) {
+  EliBatch b = { eli_load(filename), inputs, num_inputs, outdir, 0, 0 };
+  if (outdir && mkdir(outdir, 0777) && errno != EEXIST) {
+    perror(outdir);
+    return 1;
+  }
+  if (jobs > num_inputs)
+    jobs = num_inputs;
+  pthread_t* threads = calloc(jobs, sizeof(pthread_t));
+  for (int i = 1; i < jobs; i++) {
+    if (pthread_create(&threads[i], NULL, eli_batch_worker, &b)) {
+      perror("pthread_create");
+      exit(1);
+    }
+  }
+  if (jobs > 0)
+    eli_batch_worker(&b);
+  for (int i = 1; i < jobs; i++)
+    pthread_join(threads[i], NULL);
+  free(threads);
+  return b.status;
+}
+
+static int eli_cmp_str(const void* a, const void* b) {
+  return strcmp(*(char**)a, *(char**)b);
+}
+
+// Lists the *.in files of a directory in order, or the lines of a
+// manifest file.
+static char** eli_batch_inputs(const char* path, int* num_inputs) {
+  char** inputs = NULL;
+  int cap = 0;
+  int n = 0;
+  DIR* dir = opendir(path);
+  FILE* fp = dir ? NULL : fopen(path, "r");
+  if (!dir && !fp) {
+    perror(path);
+    exit(1);
+  }
+  for (;;) {
+    char* input;
+    if (dir) {
+      struct dirent* ent = readdir(dir);
+      if (!ent)
+        break;
+      size_t len = strlen(ent->d_name);
+      if (len < 4 || strcmp(ent->d_name + len - 3, ".in"))
+        continue;
+      input = malloc(strlen(path) + len + 2);
+      sprintf(input, "%s/%s", path, ent->d_name);
+    } else {
+      char* line = NULL;
+      size_t line_cap = 0;
+      ssize_t len = getline(&line, &line_cap, fp);
+      if (len < 0) {
+        free(line);
+        break;
+      }
+      while (len && (line[len - 1] == '\n' || line[len - 1] == '\r'))
+        line[--len] = 0;
+      if (!len) {
+        free(line);
+        continue;
+      }
+      input = line;
+    }
+    if (n == cap) {
+      cap = cap * 2 + 16;
+      inputs = realloc(inputs, sizeof(char*) * cap);
+    }
+    inputs[n++] = input;
+  }
+  if (dir) {
+    closedir(dir);
+    qsort(inputs, n, sizeof(char*), eli_cmp_str);
+  } else {
+    fclose(fp);
+  }
+  *num_inputs = n;
+  return inputs;
+}
 
+#endif  // ELVM_HAS_LIBELI
+
+int main(int argc, char* argv[]) {
+  bool slow = false;
+  bool jit = false;
+  bool unbuffered = false;
+  bool stats = false;
+#if defined(NOFILE) || defined(__eir__)
+#ifndef __eir__
+  eli_init_io(false);
+  eli_init_mem();
+#endif
+  Module* m = load_eir(stdin);
+#else
+  bool report_rss = false;
+  bool profile = false;
+  bool cprofile = false;
+  bool each = false;
+  bool batch = false;
+  int jobs = 0;
+  for (; argc >= 2 && argv[1][0] == '-'; argc--, argv++) {
+    if (!strcmp(argv[1], "-v")) {
+      verbose = true;
+    } else if (!strcmp(argv[1], "-slow")) {
+      slow = true;
+    } else if (!strcmp(argv[1], "-jit")) {
+      jit = true;
+    } else if (!strcmp(argv[1], "-u")) {
+      unbuffered = true;
+    } else if (!strcmp(argv[1], "-rss")) {
+      report_rss = true;
+    } else if (!strcmp(argv[1], "-profile")) {
+      profile = true;
+    } else if (!strcmp(argv[1], "-cprofile")) {
+      cprofile = true;
+#ifdef ELVM_HAS_LIBELI
+    } else if (!strcmp(argv[1], "-stats")) {
+      stats = true;
+    } else if (!strcmp(argv[1], "-each")) {
+      each = true;
+    } else if (!strcmp(argv[1], "-batch")) {
+      batch = true;
+    } else if (!strcmp(argv[1], "-j") && argc >= 3) {
+      jobs = atoi(argv[2]);
+      argc--;
+      argv++;
+#endif
+    } else {
+      fprintf(stderr, "unknown flag: %s\n", argv[1]);
+      return 1;
+    }
+  }
+
+  if (argc < 2) {
+    fprintf(stderr, "no input file\n");
+    return 1;
+  }
+#ifdef ELVM_HAS_LIBELI
+  if (each)
+    return run_batch(argv[1], argc - 2, argv + 2, NULL, 1);
+  if (batch) {
+    if (argc < 3 || argc > 4) {
+      fprintf(stderr,
+              "usage: eli -batch [-j N] prog.eir <dir|manifest> [outdir]\n");
+      return 1;
+    }
+    int num_inputs;
+    char** inputs = eli_batch_inputs(argv[2], &num_inputs);
+    if (jobs <= 0)
+      jobs = sysconf(_SC_NPROCESSORS_ONLN);
+    return run_batch(argv[1], num_inputs, inputs, argc == 4 ? argv[3] : NULL,
+                     jobs);
+  }
+#endif
+
+  eli_init_io(unbuffered);
+  eli_init_mem();
+  if (report_rss)
+    atexit(eli_report_rss);
+  Module* m = load_eir_from_file(argv[1]);
+  if (profile) {
+    // Only the reference interpreter counts.
+    slow = true;
+    eli_profile_module = m;
+    eli_counts = calloc(m->num_insts, sizeof(long));
+    char* path = malloc(strlen(argv[1]) + 14);
+    sprintf(path, "%s.profile.json", argv[1]);
+    eli_profile_path = path;
+    atexit(eli_report_profile);
+  }
+  if (cprofile) {
+    slow = true;
+    eli_init_funcs(m);
+    eli_sample_countdown = ELI_SAMPLE_PERIOD;
+    char* path = malloc(strlen(argv[1]) + 8);
+    sprintf(path, "%s.folded", argv[1]);
+    eli_stacks_path = path;
+    atexit(eli_report_cprofile);
+  }
+#endif
+
+#ifdef ELVM_HAS_LIBELI
+  if (!jit && !slow && !verbose)
+    run_libeli(m, unbuffered, stats);
+#endif
+
+  memcpy(mem, m->data_words, sizeof(int) * m->num_data_words);
+
+  if (jit && !verbose && !slow) {
+#ifdef ELVM_HAS_JIT
+    jit_run(m, regs, mem, MEMSZ, eli_putc, eli_getc);
+#else
+    fprintf(stderr, "-jit is not supported on this host\n");
+    return 1;
+#endif
+  }
+  run_slow(m);
   return 0;
 }
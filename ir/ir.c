@@ -7,8 +7,12 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include <ir/arena.h>
+#include <ir/eirb.h>
 #include <ir/table.h>
 
+#define IR_BUF_SIZE 65536
+
 static bool g_split_basic_block_by_mem = false;
 
 static char g_current_magic_comment[64];
@@ -16,6 +20,7 @@ static char g_current_magic_comment[64];
 typedef struct DataPrivate_ {
   int v;
   struct DataPrivate_* next;
+  LabelKind label;
   Value val;
   int lineno;
 } DataPrivate;
@@ -25,12 +30,21 @@ typedef struct {
   int lineno;
   int col;
   FILE* fp;
+  Arena* arena;
+  unsigned char* buf;
+  unsigned char* cur;
+  unsigned char* end;
   Table* symtab;
+  Table* names;
+  // Maps .file numbers to file names.
+  Table* files;
+  SrcLoc* loc;
   int in_text;
   Inst* text;
   int pc;
   int subsection;
   DataPrivate* data;
+  Sym* syms;
   bool prev_boundary;
 } Parser;
 
@@ -50,8 +64,35 @@ static void ir_error(Parser* p, const char* msg) {
   exit(1);
 }
 
-static int ir_getc(Parser* p) {
-  int c = fgetc(p->fp);
+// Refills the input buffer. The last consumed byte is kept in front of
+// the new chunk so that ir_ungetc can always step back by one.
+static bool fill_buf(Parser* p) {
+  if (p->cur != p->buf)
+    p->buf[0] = p->cur[-1];
+  unsigned char* dst = p->buf + 1;
+  int n = 0;
+#ifdef __eir__
+  // ELVM's libc has no fread.
+  for (; n < IR_BUF_SIZE; n++) {
+    int c = fgetc(p->fp);
+    if (c == EOF)
+      break;
+    dst[n] = c;
+  }
+#else
+  n = fread(dst, 1, IR_BUF_SIZE, p->fp);
+#endif
+  p->cur = dst;
+  p->end = dst + n;
+  return n > 0;
+}
+
+static inline int ir_getc(Parser* p) {
+  if (p->cur == p->end && !fill_buf(p)) {
+    p->col++;
+    return EOF;
+  }
+  int c = *p->cur++;
   if (c == '\n') {
     p->lineno++;
     p->col = 0;
@@ -61,17 +102,19 @@ static int ir_getc(Parser* p) {
   return c;
 }
 
-static void ir_ungetc(Parser* p, int c) {
+static inline void ir_ungetc(Parser* p, int c) {
+  if (c == EOF)
+    return;
   if (c == '\n') {
     p->lineno--;
   }
-  ungetc(c, p->fp);
+  p->cur--;
 }
 
-static int peek(Parser* p) {
-  int c = fgetc(p->fp);
-  ungetc(c, p->fp);
-  return c;
+static inline int peek(Parser* p) {
+  if (p->cur == p->end && !fill_buf(p))
+    return EOF;
+  return *p->cur;
 }
 
 static void skip_until_ret(Parser* p) {
@@ -122,6 +165,17 @@ static void read_while_ident(Parser* p, char* buf, int len) {
   ir_error(p, "too long ident");
 }
 
+// Returns a shared copy of |name| so each identifier is allocated once
+// and symbol lookups can match by pointer.
+static char* intern(Parser* p, const char* name) {
+  const void* r;
+  if (table_get(p->names, name, &r))
+    return (char*)r;
+  char* s = arena_strdup(p->arena, name);
+  p->names = table_add(p->names, s, s);
+  return s;
+}
+
 static int read_int(Parser* p, int c) {
   bool is_minus = false;
   int r = 0;
@@ -141,8 +195,7 @@ static int read_int(Parser* p, int c) {
 }
 
 static DataPrivate* add_data(Parser* p) {
-  DataPrivate* n = malloc(sizeof(DataPrivate));
-  n->next = 0;
+  DataPrivate* n = arena_alloc(p->arena, sizeof(DataPrivate));
   n->v = p->subsection;
   n->lineno = p->lineno;
   p->data->next = n;
@@ -150,6 +203,22 @@ static DataPrivate* add_data(Parser* p) {
   return n;
 }
 
+static Sym* new_sym(Parser* p, const char* name, int value, int is_text) {
+  Sym* s = arena_alloc(p->arena, sizeof(Sym));
+  s->name = name;
+  s->value = value;
+  s->is_text = is_text;
+  return s;
+}
+
+// Defines a label of the source. The symbol table maps names to Syms.
+static void add_sym(Parser* p, const char* name, int value, int is_text) {
+  Sym* s = new_sym(p, name, value, is_text);
+  p->symtab = table_add(p->symtab, name, s);
+  p->syms->next = s;
+  p->syms = s;
+}
+
 static void add_imm_data(Parser* p, int v) {
   DataPrivate* n = add_data(p);
   n->val.type = IMM;
@@ -174,7 +243,7 @@ static void serialize_data(Parser* p, DataPrivate* data_root) {
       prev->next = data->next;
 
       if (data->val.type == (ValueType)LABEL) {
-        p->symtab = table_add(p->symtab, data->val.tmp, (void*)mp);
+        add_sym(p, data->val.tmp, mp, 0);
       } else {
         serialized->next = data;
         serialized = data;
@@ -185,10 +254,9 @@ static void serialize_data(Parser* p, DataPrivate* data_root) {
     }
   }
 
-  p->symtab = table_add(p->symtab, "_edata", (void*)mp);
-  serialized->next = malloc(sizeof(DataPrivate));
+  p->symtab = table_add(p->symtab, "_edata", new_sym(p, "_edata", mp, 0));
+  serialized->next = arena_alloc(p->arena, sizeof(DataPrivate));
   serialized->next->v = mp + 1;
-  serialized->next->next = 0;
   serialized->next->val.type = IMM;
   serialized->next->val.imm = mp + 1;
   data_root->next = serialized_root.next;
@@ -215,6 +283,22 @@ static Op get_op(Parser* p, const char* buf) {
     return EXIT;
   } else if (!strcmp(buf, "dump")) {
     return DUMP;
+  } else if (!strcmp(buf, "mul")) {
+    return MUL;
+  } else if (!strcmp(buf, "div")) {
+    return DIV;
+  } else if (!strcmp(buf, "mod")) {
+    return MOD;
+  } else if (!strcmp(buf, "and")) {
+    return AND;
+  } else if (!strcmp(buf, "or")) {
+    return OR;
+  } else if (!strcmp(buf, "xor")) {
+    return XOR;
+  } else if (!strcmp(buf, "shl")) {
+    return SHL;
+  } else if (!strcmp(buf, "shr")) {
+    return SHR;
   } else if (!strcmp(buf, "jeq")) {
     return JEQ;
   } else if (!strcmp(buf, "jne")) {
@@ -257,6 +341,48 @@ static Op get_op(Parser* p, const char* buf) {
   return OP_UNSET;
 }
 
+// .file <number> "<name>"
+static void parse_file(Parser* p) {
+  char num[16];
+  char name[256];
+  skip_ws(p);
+  sprintf(num, "%d", read_int(p, ir_getc(p)));
+  skip_ws(p);
+  if (ir_getc(p) != '"')
+    ir_error(p, "expected open '\"'");
+  int len = 0;
+  for (;;) {
+    int c = ir_getc(p);
+    if (c == '"')
+      break;
+    if (c == '\\')
+      c = ir_getc(p);
+    if (c == '\n' || c == EOF)
+      ir_error(p, "unterminated file name");
+    if (len == 255)
+      ir_error(p, "file name too long");
+    name[len++] = c;
+  }
+  name[len] = 0;
+  p->files = table_add(p->files, intern(p, num), intern(p, name));
+  skip_until_ret(p);
+}
+
+// .loc <file number> <line> [<column>]
+static void parse_loc(Parser* p) {
+  char num[16];
+  skip_ws(p);
+  sprintf(num, "%d", read_int(p, ir_getc(p)));
+  skip_ws(p);
+  int line = read_int(p, ir_getc(p));
+  const void* file = NULL;
+  table_get(p->files, num, &file);
+  p->loc = arena_alloc(p->arena, sizeof(SrcLoc));
+  p->loc->file = file;
+  p->loc->line = line;
+  skip_until_ret(p);
+}
+
 static void parse_line(Parser* p, int c) {
   char buf[64];
   buf[0] = c;
@@ -315,10 +441,10 @@ static void parse_line(Parser* p, int c) {
     add_imm_data(p, 0);
     return;
   } else if (op == (Op)FILENAME) {
-    skip_until_ret(p);
+    parse_file(p);
     return;
   } else if (op == (Op)LOC) {
-    skip_until_ret(p);
+    parse_loc(p);
     return;
   } else if (op == OP_UNSET) {
     c = ir_getc(p);
@@ -329,11 +455,11 @@ static void parse_line(Parser* p, int c) {
           p->pc++;
         value = p->pc;
         p->prev_boundary = true;
-        p->symtab = table_add(p->symtab, strdup(buf), (void*)value);
+        add_sym(p, intern(p, buf), value, 1);
       } else {
         DataPrivate* d = add_data(p);
         d->val.type = (ValueType)LABEL;
-        d->val.tmp = strdup(buf);
+        d->val.tmp = intern(p, buf);
       }
       return;
     }
@@ -358,6 +484,8 @@ static void parse_line(Parser* p, int c) {
     argc = 2;
   else if (op == DUMP)
     argc = 0;
+  else if (op <= SHR)
+    argc = 2;
   else if (op == (Op)LONG)
     argc = 1;
   else if (op == (Op)DATA) {
@@ -378,6 +506,7 @@ static void parse_line(Parser* p, int c) {
     }
 
     Value a;
+    a.label = NO_LABEL;
     c = ir_getc(p);
     if (isdigit(c) || c == '-') {
       a.type = IMM;
@@ -400,7 +529,7 @@ static void parse_line(Parser* p, int c) {
         a.reg = BP;
       } else {
         a.type = (ValueType)REF;
-        a.tmp = strdup(buf);
+        a.tmp = intern(p, buf);
       }
     }
     args[i] = a;
@@ -427,13 +556,15 @@ static void parse_line(Parser* p, int c) {
     return;
   }
 
-  p->text->next = calloc(1, sizeof(Inst));
+  p->text->next = arena_alloc(p->arena, sizeof(Inst));
   p->text = p->text->next;
   p->text->op = op;
   p->text->pc = p->pc;
   p->text->lineno = p->lineno;
+  p->text->loc = p->loc;
   if (g_current_magic_comment[0]) {
-    p->text->magic_comment = strdup(g_current_magic_comment);
+    p->text->magic_comment =
+        arena_strdup(p->arena, g_current_magic_comment);
     g_current_magic_comment[0] = '\0';
   }
   p->prev_boundary = false;
@@ -454,6 +585,14 @@ static void parse_line(Parser* p, int c) {
     case GT:
     case LE:
     case GE:
+    case MUL:
+    case DIV:
+    case MOD:
+    case AND:
+    case OR:
+    case XOR:
+    case SHL:
+    case SHR:
       p->text->src = args[1];
       FALLTHROUGH;
     case GETC:
@@ -490,16 +629,18 @@ static void parse_line(Parser* p, int c) {
 static void parse_eir(Parser* p) {
   Inst text_root = {};
   DataPrivate data_root = {};
+  Sym sym_root = {};
   int c;
 
   p->in_text = 1;
   p->lineno = 1;
   p->text = &text_root;
   p->data = &data_root;
+  p->syms = &sym_root;
   p->pc = 0;
   p->prev_boundary = true;
 
-  p->text->next = calloc(1, sizeof(Inst));
+  p->text->next = arena_alloc(p->arena, sizeof(Inst));
   p->text = p->text->next;
   p->text->op = JMP;
   p->text->pc = p->pc++;
@@ -507,7 +648,7 @@ static void parse_eir(Parser* p) {
   p->text->jmp.type = (ValueType)REF;
   p->text->jmp.tmp = "main";
   p->text->next = 0;
-  p->symtab = table_add(p->symtab, "main", (void*)1);
+  p->symtab = table_add(p->symtab, "main", new_sym(p, "main", 1, 1));
 
   for (;;) {
     skip_ws(p);
@@ -533,18 +674,22 @@ static void parse_eir(Parser* p) {
   serialize_data(p, &data_root);
   p->text = text_root.next;
   p->data = data_root.next;
+  p->syms = sym_root.next;
 }
 
 static void resolve(Value* v, Table* symtab) {
   if (v->type != (ValueType)REF)
     return;
   const char* name = (const char*)v->tmp;
-  if (!table_get(symtab, name, (void*)&v->imm)) {
+  const Sym* sym;
+  if (!table_get(symtab, name, (const void**)&sym)) {
     fprintf(stderr, "undefined sym: %s\n", name);
     exit(1);
   }
-  //fprintf(stderr, "resolved: %s %d\n", name, v->imm);
+  //fprintf(stderr, "resolved: %s %d\n", name, sym->value);
   v->type = IMM;
+  v->imm = sym->value;
+  v->label = sym->is_text ? TEXT_LABEL : DATA_LABEL;
 }
 
 static void resolve_syms(Parser* p) {
@@ -553,6 +698,7 @@ static void resolve_syms(Parser* p) {
       resolve(&data->val, p->symtab);
     }
     data->v = MOD24(data->val.imm);
+    data->label = data->val.label;
   }
 
   for (Inst* inst = p->text; inst; inst = inst->next) {
@@ -565,14 +711,24 @@ static void resolve_syms(Parser* p) {
 Module* load_eir_impl(const char* filename, FILE* fp) {
   Parser parser = {
     .filename = filename,
-    .fp = fp
+    .fp = fp,
+    .arena = arena_new()
   };
+  parser.buf = malloc(IR_BUF_SIZE + 1);
+  parser.cur = parser.end = parser.buf;
   parse_eir(&parser);
+  free(parser.buf);
   resolve_syms(&parser);
+  table_free(parser.symtab);
+  table_free(parser.names);
+  table_free(parser.files);
 
-  Module* m = malloc(sizeof(Module));
+  Module* m = calloc(1, sizeof(Module));
   m->text = parser.text;
   m->data = (Data*)parser.data;
+  m->syms = parser.syms;
+  m->arena = parser.arena;
+  index_module(m);
   return m;
 }
 
@@ -586,20 +742,130 @@ Module* load_eir_from_file(const char* filename) {
     fprintf(stderr, "no such file: %s\n", filename);
     exit(1);
   }
+#ifndef __eir__
+  char magic[4];
+  if (fread(magic, 1, 4, fp) == 4 && !memcmp(magic, EIRB_MAGIC, 4)) {
+    fclose(fp);
+    if (g_split_basic_block_by_mem) {
+      // Data words may hold code addresses, so pcs can't be renumbered
+      // after symbols are resolved.
+      fprintf(stderr, "%s: binary EIR doesn't support this target\n",
+              filename);
+      exit(1);
+    }
+    return load_eir_binary(filename);
+  }
+  rewind(fp);
+#endif
   Module* r = load_eir_impl(filename, fp);
   fclose(fp);
   return r;
 }
 
+void free_module(Module* m) {
+  arena_free(m->arena);
+  free(m);
+}
+
+void index_module(Module* m) {
+  int n = 0;
+  bool contiguous = true;
+  for (Inst* inst = m->text; inst; inst = inst->next) {
+    if (inst->next && inst->next != inst + 1)
+      contiguous = false;
+    n++;
+  }
+  if (!contiguous) {
+    Inst* insts = arena_alloc(m->arena, sizeof(Inst) * n);
+    Inst* inst = m->text;
+    for (int i = 0; i < n; i++, inst = inst->next) {
+      insts[i] = *inst;
+      insts[i].next = i + 1 < n ? &insts[i + 1] : NULL;
+    }
+    m->text = insts;
+  }
+  m->insts = m->text;
+  m->num_insts = n;
+
+  int num_blocks = n ? m->insts[n - 1].pc + 1 : 0;
+  BasicBlock* blocks = arena_alloc(m->arena, sizeof(BasicBlock) * num_blocks);
+  int pc = 0;
+  for (int i = 0; i < n; i++) {
+    int ipc = m->insts[i].pc;
+    for (; pc <= ipc; pc++)
+      blocks[pc].start = i;
+    blocks[ipc].len++;
+  }
+  for (; pc < num_blocks; pc++)
+    blocks[pc].start = n;
+  m->blocks = blocks;
+  m->num_blocks = num_blocks;
+
+  int num_data_words = 0;
+  for (Data* d = m->data; d; d = d->next)
+    num_data_words++;
+  int* data_words = arena_alloc(m->arena, sizeof(int) * num_data_words);
+  int i = 0;
+  for (Data* d = m->data; d; d = d->next)
+    data_words[i++] = d->v;
+  m->data_words = data_words;
+  m->num_data_words = num_data_words;
+}
+
 void split_basic_block_by_mem() {
   g_split_basic_block_by_mem = true;
 }
 
+int is_basic_block_split_by_mem() {
+  return g_split_basic_block_by_mem;
+}
+
+int is_ext_op(Op op) {
+  return op >= MUL && op <= SHR;
+}
+
+int eval_ext_op(Op op, int d, int s) {
+  unsigned int a = d;
+  unsigned int b = s;
+  unsigned int r;
+  switch (op) {
+    case MUL:
+      r = a * b;
+      break;
+    case DIV:
+      r = b ? a / b : UINT_MAX;
+      break;
+    case MOD:
+      r = b ? a % b : a;
+      break;
+    case AND:
+      r = a & b;
+      break;
+    case OR:
+      r = a | b;
+      break;
+    case XOR:
+      r = a ^ b;
+      break;
+    case SHL:
+      r = b < 24 ? a << b : 0;
+      break;
+    case SHR:
+      r = b < 24 ? a >> b : 0;
+      break;
+    default:
+      fprintf(stderr, "not an extended op: %d\n", op);
+      exit(1);
+  }
+  return MOD24((int)r);
+}
+
 void dump_op(Op op, FILE* fp) {
   static const char* op_strs[] = {
     "mov", "add", "sub", "load", "store", "putc", "getc", "exit",
     "jeq", "jne", "jlt", "jgt", "jle", "jge", "jmp", "xxx",
-    "eq", "ne", "lt", "gt", "le", "ge", "dump"
+    "eq", "ne", "lt", "gt", "le", "ge", "dump",
+    "mul", "div", "mod", "and", "or", "xor", "shl", "shr"
   };
   fprintf(fp, "%s", op_strs[op]);
 }
@@ -631,6 +897,14 @@ void dump_inst_fp(Inst* inst, FILE* fp) {
     case GT:
     case LE:
     case GE:
+    case MUL:
+    case DIV:
+    case MOD:
+    case AND:
+    case OR:
+    case XOR:
+    case SHL:
+    case SHR:
       fprintf(fp, " ");
       dump_val(&inst->dst, fp);
       fprintf(fp, " ");
@@ -19,17 +19,30 @@ typedef enum {
   REG, IMM
 } ValueType;
 
+// What an immediate referred to in the source. Passes which move code or
+// data rely on this to tell addresses from plain numbers.
+typedef enum {
+  NO_LABEL, TEXT_LABEL, DATA_LABEL
+} LabelKind;
+
 typedef enum {
   OP_UNSET = -2, OP_ERR = -1,
   MOV = 0, ADD, SUB, LOAD, STORE, PUTC, GETC, EXIT,
   JEQ = 8, JNE, JLT, JGT, JLE, JGE, JMP,
   // Optional operations follow.
   EQ = 16, NE, LT, GT, LE, GE, DUMP,
+  // Extended arithmetic, only for targets which declare support for it
+  // in elc. lower_ext_ops rewrites them into loops of the core
+  // operations for the others. All of them compute dst = dst op src on
+  // unsigned words. Division by zero gives UINT_MAX and a remainder of
+  // dst, and shifts by 24 or more give 0.
+  MUL, DIV, MOD, AND, OR, XOR, SHL, SHR,
   LAST_OP
 } Op;
 
 typedef struct {
   ValueType type;
+  LabelKind label;
   union {
     Reg reg;
     int imm;
@@ -37,6 +50,13 @@ typedef struct {
   };
 } Value;
 
+// A position in the C source, from .file and .loc directives. |file| is
+// NULL if .loc named a file number which was not declared.
+typedef struct {
+  const char* file;
+  int line;
+} SrcLoc;
+
 typedef struct Inst_ {
   Op op;
   Value dst;
@@ -45,25 +65,77 @@ typedef struct Inst_ {
   int pc;
   int lineno;
   char* magic_comment;
+  // The last .loc before the instruction, or NULL. Instructions after
+  // the same .loc share it.
+  SrcLoc* loc;
   struct Inst_* next;
 } Inst;
 
 typedef struct Data_ {
   int v;
   struct Data_* next;
+  LabelKind label;
 } Data;
 
+// A label defined in the source. |value| is a pc for text labels and a
+// data address otherwise.
+typedef struct Sym_ {
+  const char* name;
+  int value;
+  int is_text;
+  struct Sym_* next;
+} Sym;
+
+// Instructions of a basic block are insts[start] ... insts[start+len-1].
+// A pc with no instructions has len 0 and starts at the next block.
+typedef struct {
+  int start;
+  int len;
+} BasicBlock;
+
+// All instructions, data and strings of a loaded module live in its
+// arena, so free_module releases them in one go.
+//
+// Besides the lists, a module has array views built by index_module:
+// |text| points into |insts|, |blocks| is indexed by pc, and |data_words|
+// holds the values of |data| in address order.
 typedef struct {
   Inst* text;
   Data* data;
+  Sym* syms;
+  Inst* insts;
+  int num_insts;
+  BasicBlock* blocks;
+  int num_blocks;
+  int* data_words;
+  int num_data_words;
+  struct Arena_* arena;
 } Module;
 
 Module* load_eir(FILE* fp);
 
 Module* load_eir_from_file(const char* filename);
 
+// Loads a module written by `elc -eirb`. load_eir_from_file also
+// accepts such files.
+Module* load_eir_binary(const char* filename);
+
+void free_module(Module* m);
+
+// (Re)builds the array views of |m| from its lists. Passes which rewrite
+// text or data must call this afterwards.
+void index_module(Module* m);
+
 void split_basic_block_by_mem();
+int is_basic_block_split_by_mem();
+
+// Whether |op| is one of the extended arithmetic operations.
+int is_ext_op(Op op);
+
+// The result of extended operation |op| on words |d| and |s|.
+int eval_ext_op(Op op, int d, int s);
 
+void dump_op(Op op, FILE* fp);
 void dump_inst(Inst* inst);
 void dump_inst_fp(Inst* inst, FILE* fp);
 
@@ -0,0 +1,493 @@
+#include <ir/jit.h>
+
+#ifdef ELVM_HAS_JIT
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+
+#define JIT_BUF_SIZE (256 << 20)
+#define JIT_MASK 0xffffff
+
+enum {
+  JIT_RAX = 0, JIT_RCX = 1, JIT_RDX = 2, JIT_RSP = 4, JIT_RSI = 6,
+  JIT_RDI = 7
+};
+
+// Host registers for A, B, C, D, BP and SP. They are all callee-saved,
+// so calls into C keep them. rsi holds the base of memory.
+static const int JIT_REGS[6] = { 3, 5, 12, 13, 14, 15 };
+
+// x86 condition codes for JEQ ... JGE and EQ ... GE.
+static const int JIT_CC[6] = { 0x4, 0x5, 0xc, 0xf, 0xe, 0xd };
+
+// Why compiled code returned to jit_run, passed in rdx with a pc in
+// eax. Any other value of rdx is the address of a rel32 which should be
+// patched to reach the block of the pc.
+enum {
+  JIT_EXIT_DISPATCH, JIT_EXIT_EXIT, JIT_EXIT_LOAD, JIT_EXIT_STORE
+};
+
+// An out-of-line exit of a block, emitted after its body.
+typedef struct {
+  unsigned char* rel;
+  int kind;
+  int pc;
+} JitStub;
+
+typedef struct {
+  Module* m;
+  int* regs;
+  int* mem;
+  int mem_size;
+  unsigned char* p;
+  unsigned char* end;
+  unsigned char** blocks;
+  unsigned char* exit;
+  unsigned char* exit_dispatch;
+  int (*enter)(unsigned char* code);
+  uintptr_t site;
+  void (*putc_fn)(int);
+  int (*getc_fn)(void);
+  JitStub* stubs;
+  int num_stubs;
+} Jit;
+
+static Jit jit;
+
+__attribute__((noreturn))
+static void jit_error(const char* msg, int pc) {
+  fprintf(stderr, "%s (pc=%d)\n", msg, pc);
+  exit(1);
+}
+
+static void jit_putc(int c) {
+  jit.putc_fn(c);
+}
+
+static int jit_getc(void) {
+  int c = jit.getc_fn();
+  return (c == EOF ? 0 : c) & JIT_MASK;
+}
+
+static void jit_emit1(int b) {
+  *jit.p++ = b;
+}
+
+static void jit_emit4(uint32_t v) {
+  memcpy(jit.p, &v, 4);
+  jit.p += 4;
+}
+
+static void jit_emit8(uint64_t v) {
+  memcpy(jit.p, &v, 8);
+  jit.p += 8;
+}
+
+static void jit_rex(int w, int reg, int index, int rm) {
+  int rex = w << 3 | (reg >> 3) << 2 | (index >> 3) << 1 | rm >> 3;
+  if (rex)
+    jit_emit1(0x40 | rex);
+}
+
+static void jit_modrm(int mod, int reg, int rm) {
+  jit_emit1(mod << 6 | (reg & 7) << 3 | (rm & 7));
+}
+
+// |op| r/m32, r32 (or the reverse, depending on |op|).
+static void jit_rr(int op, int reg, int rm) {
+  jit_rex(0, reg, 0, rm);
+  jit_emit1(op);
+  jit_modrm(3, reg, rm);
+}
+
+// Group 1 operation |ext| (0=add 1=or 4=and 5=sub 6=xor 7=cmp) r/m32,
+// imm32.
+static void jit_ri(int ext, int rm, int imm) {
+  jit_rex(0, 0, 0, rm);
+  jit_emit1(0x81);
+  jit_modrm(3, ext, rm);
+  jit_emit4(imm);
+}
+
+static void jit_mov_imm(int r, int imm) {
+  jit_rex(0, 0, 0, r);
+  jit_emit1(0xb8 + (r & 7));
+  jit_emit4(imm);
+}
+
+static void jit_movabs(int r, const void* p) {
+  jit_rex(1, 0, 0, r);
+  jit_emit1(0xb8 + (r & 7));
+  jit_emit8((uintptr_t)p);
+}
+
+static void jit_mov_value(int r, Value* v) {
+  if (v->type == REG)
+    jit_rr(0x89, JIT_REGS[v->reg], r);
+  else
+    jit_mov_imm(r, v->imm);
+}
+
+static void jit_alu(int ext, int r, Value* v) {
+  if (v->type == REG)
+    jit_rr(ext * 8 + 1, JIT_REGS[v->reg], r);
+  else
+    jit_ri(ext, r, v->imm);
+}
+
+// mov r32, [rsi + index * 4] (0x8b) or mov [rsi + index * 4], r32 (0x89).
+static void jit_mem_index(int op, int r, int index) {
+  jit_rex(0, r, index, JIT_RSI);
+  jit_emit1(op);
+  jit_modrm(0, r, JIT_RSP);
+  jit_emit1(2 << 6 | (index & 7) << 3 | JIT_RSI);
+}
+
+static void jit_mem_disp(int op, int r, int disp) {
+  jit_rex(0, r, 0, JIT_RSI);
+  jit_emit1(op);
+  jit_modrm(2, r, JIT_RSI);
+  jit_emit4(disp);
+}
+
+// mov r32, [rdi + disp8] (0x8b) or mov [rdi + disp8], r32 (0x89).
+static void jit_regs_slot(int op, int r, int disp) {
+  jit_rex(0, r, 0, JIT_RDI);
+  jit_emit1(op);
+  jit_modrm(1, r, JIT_RDI);
+  jit_emit1(disp);
+}
+
+static void jit_call(const void* fn) {
+  jit_movabs(JIT_RAX, fn);
+  jit_emit1(0xff);
+  jit_emit1(0xd0);
+  jit_movabs(JIT_RSI, jit.mem);
+}
+
+// Emits jcc rel32 (or jmp rel32 if |cc| is -1) and returns the address
+// of its displacement.
+static unsigned char* jit_jump(int cc) {
+  if (cc < 0) {
+    jit_emit1(0xe9);
+  } else {
+    jit_emit1(0x0f);
+    jit_emit1(0x80 | cc);
+  }
+  unsigned char* rel = jit.p;
+  jit_emit4(0);
+  return rel;
+}
+
+static void jit_patch(unsigned char* rel, unsigned char* to) {
+  int32_t v = to - (rel + 4);
+  memcpy(rel, &v, 4);
+}
+
+static void jit_add_stub(unsigned char* rel, int kind, int pc) {
+  JitStub* s = &jit.stubs[jit.num_stubs++];
+  s->rel = rel;
+  s->kind = kind;
+  s->pc = pc;
+}
+
+static bool jit_is_valid_pc(int pc) {
+  Module* m = jit.m;
+  return pc >= 0 && pc < m->num_blocks && m->blocks[pc].start != m->num_insts;
+}
+
+static void jit_goto(int cc, int pc) {
+  unsigned char* rel = jit_jump(cc);
+  if (!jit_is_valid_pc(pc))
+    jit_add_stub(rel, JIT_EXIT_DISPATCH, pc);
+  else if (jit.blocks[pc])
+    jit_patch(rel, jit.blocks[pc]);
+  else
+    jit_add_stub(rel, -1, pc);
+}
+
+// Jumps to the block of the pc in |r|, looking it up inline and leaving
+// it to jit_run when the block is not compiled yet or is out of text.
+static void jit_goto_reg(int cc, int r) {
+  unsigned char* skip = NULL;
+  if (cc >= 0)
+    skip = jit_jump(cc ^ 1);
+  jit_rr(0x89, r, JIT_RAX);
+  jit_ri(7, JIT_RAX, jit.m->num_blocks);
+  jit_patch(jit_jump(0x3), jit.exit_dispatch);
+  jit_movabs(JIT_RCX, jit.blocks);
+  // mov rcx, [rcx + rax * 8]; test rcx, rcx
+  jit_emit1(0x48);
+  jit_emit1(0x8b);
+  jit_emit1(0x0c);
+  jit_emit1(0xc1);
+  jit_emit1(0x48);
+  jit_emit1(0x85);
+  jit_emit1(0xc9);
+  jit_patch(jit_jump(0x4), jit.exit_dispatch);
+  // jmp rcx
+  jit_emit1(0xff);
+  jit_emit1(0xe1);
+  if (skip)
+    jit_patch(skip, jit.p);
+}
+
+static void jit_mem(Inst* inst, int pc) {
+  int op = inst->op == LOAD ? 0x8b : 0x89;
+  int kind = inst->op == LOAD ? JIT_EXIT_LOAD : JIT_EXIT_STORE;
+  int d = JIT_REGS[inst->dst.reg];
+  if (inst->src.type == REG) {
+    int r = JIT_REGS[inst->src.reg];
+    jit_ri(7, r, jit.mem_size);
+    jit_add_stub(jit_jump(0x3), kind, pc);
+    jit_mem_index(op, d, r);
+  } else if (inst->src.imm < 0 || inst->src.imm >= jit.mem_size) {
+    jit_add_stub(jit_jump(-1), kind, pc);
+  } else {
+    jit_mem_disp(op, d, inst->src.imm * 4);
+  }
+}
+
+static void jit_inst(Inst* inst, int pc) {
+  int d = inst->dst.type == REG ? JIT_REGS[inst->dst.reg] : -1;
+  switch (inst->op) {
+    case MOV:
+      jit_mov_value(d, &inst->src);
+      break;
+
+    case ADD:
+      jit_alu(0, d, &inst->src);
+      jit_ri(4, d, JIT_MASK);
+      break;
+
+    case SUB:
+      jit_alu(5, d, &inst->src);
+      jit_ri(4, d, JIT_MASK);
+      break;
+
+    case LOAD:
+    case STORE:
+      jit_mem(inst, pc);
+      break;
+
+    case PUTC:
+      jit_mov_value(JIT_RDI, &inst->src);
+      jit_call(jit_putc);
+      break;
+
+    case GETC:
+      jit_call(jit_getc);
+      jit_rr(0x89, JIT_RAX, d);
+      break;
+
+    case EXIT:
+      jit_add_stub(jit_jump(-1), JIT_EXIT_EXIT, pc);
+      break;
+
+    case DUMP:
+      break;
+
+    case EQ:
+    case NE:
+    case LT:
+    case GT:
+    case LE:
+    case GE:
+      jit_alu(7, d, &inst->src);
+      // setcc al; movzx d, al
+      jit_emit1(0x0f);
+      jit_emit1(0x90 | JIT_CC[inst->op - EQ]);
+      jit_emit1(0xc0);
+      jit_rex(0, d, 0, 0);
+      jit_emit1(0x0f);
+      jit_emit1(0xb6);
+      jit_modrm(3, d, JIT_RAX);
+      break;
+
+    case MUL:
+      if (inst->src.type == REG) {
+        int s = JIT_REGS[inst->src.reg];
+        jit_rex(0, d, 0, s);
+        jit_emit1(0x0f);
+        jit_emit1(0xaf);
+        jit_modrm(3, d, s);
+      } else {
+        jit_rex(0, d, 0, d);
+        jit_emit1(0x69);
+        jit_modrm(3, d, d);
+        jit_emit4(inst->src.imm);
+      }
+      jit_ri(4, d, JIT_MASK);
+      break;
+
+    case AND:
+    case OR:
+    case XOR:
+      jit_alu(inst->op == AND ? 4 : inst->op == OR ? 1 : 6, d, &inst->src);
+      jit_ri(4, d, JIT_MASK);
+      break;
+
+    case DIV:
+    case MOD:
+    case SHL:
+    case SHR:
+      jit_mov_imm(JIT_RDI, inst->op);
+      jit_rr(0x89, d, JIT_RSI);
+      jit_mov_value(JIT_RDX, &inst->src);
+      jit_call(eval_ext_op);
+      jit_rr(0x89, JIT_RAX, d);
+      break;
+
+    case JEQ:
+    case JNE:
+    case JLT:
+    case JGT:
+    case JLE:
+    case JGE:
+    case JMP: {
+      int cc = -1;
+      if (inst->op != JMP) {
+        jit_alu(7, d, &inst->src);
+        cc = JIT_CC[inst->op - JEQ];
+      }
+      if (inst->jmp.type == REG)
+        jit_goto_reg(cc, JIT_REGS[inst->jmp.reg]);
+      else
+        jit_goto(cc, inst->jmp.imm);
+      break;
+    }
+
+    default:
+      jit_error("oops", pc);
+  }
+}
+
+static unsigned char* jit_block(int pc) {
+  if (jit.blocks[pc])
+    return jit.blocks[pc];
+
+  BasicBlock* bb = &jit.m->blocks[pc];
+  if (jit.end - jit.p < 96 * (bb->len + 1))
+    jit_error("out of JIT code space", pc);
+  unsigned char* code = jit.p;
+  // Registered first, so a block which loops to itself jumps directly.
+  jit.blocks[pc] = code;
+
+  jit.stubs = malloc(sizeof(JitStub) * (bb->len + 1));
+  jit.num_stubs = 0;
+  Inst* last = NULL;
+  for (int i = 0; i < bb->len; i++) {
+    last = &jit.m->insts[bb->start + i];
+    jit_inst(last, pc);
+  }
+  if (!last || last->op != JMP)
+    jit_goto(-1, pc + 1);
+
+  for (int i = 0; i < jit.num_stubs; i++) {
+    JitStub* s = &jit.stubs[i];
+    jit_patch(s->rel, jit.p);
+    jit_mov_imm(JIT_RAX, s->pc);
+    if (s->kind < 0) {
+      jit_movabs(JIT_RDX, s->rel);
+    } else {
+      jit_mov_imm(JIT_RDX, s->kind);
+    }
+    jit_patch(jit_jump(-1), jit.exit);
+  }
+  free(jit.stubs);
+  return code;
+}
+
+static void jit_init(Module* m, int* regs, int* mem, int mem_size) {
+  jit.m = m;
+  jit.regs = regs;
+  jit.mem = mem;
+  jit.mem_size = mem_size;
+  jit.blocks = calloc(m->num_blocks, sizeof(*jit.blocks));
+  jit.p = mmap(NULL, JIT_BUF_SIZE, PROT_READ | PROT_WRITE | PROT_EXEC,
+               MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+  if (jit.p == MAP_FAILED) {
+    perror("mmap");
+    exit(1);
+  }
+  jit.end = jit.p + JIT_BUF_SIZE;
+
+  // int enter(code): saves callee-saved registers, loads the EIR
+  // registers and jumps to |code| with a 16-byte aligned stack.
+  jit.enter = (int (*)(unsigned char*))jit.p;
+  for (int i = 0; i < 6; i++) {
+    jit_rex(0, 0, 0, JIT_REGS[i]);
+    jit_emit1(0x50 + (JIT_REGS[i] & 7));
+  }
+  // sub rsp, 8; mov rax, rdi
+  jit_emit1(0x48);
+  jit_emit1(0x83);
+  jit_emit1(0xec);
+  jit_emit1(0x08);
+  jit_emit1(0x48);
+  jit_rr(0x89, JIT_RDI, JIT_RAX);
+  jit_movabs(JIT_RDI, regs);
+  for (int i = 0; i < 6; i++)
+    jit_regs_slot(0x8b, JIT_REGS[i], i * 4);
+  jit_movabs(JIT_RSI, mem);
+  // jmp rax
+  jit_emit1(0xff);
+  jit_emit1(0xe0);
+
+  // The exit stores the EIR registers back, records rdx in |site| and
+  // returns eax. exit_dispatch clears rdx first.
+  jit.exit_dispatch = jit.p;
+  // xor edx, edx
+  jit_emit1(0x31);
+  jit_emit1(0xd2);
+  jit.exit = jit.p;
+  jit_movabs(JIT_RDI, regs);
+  for (int i = 0; i < 6; i++)
+    jit_regs_slot(0x89, JIT_REGS[i], i * 4);
+  jit_movabs(JIT_RCX, &jit.site);
+  // mov [rcx], rdx; add rsp, 8
+  jit_emit1(0x48);
+  jit_emit1(0x89);
+  jit_emit1(0x11);
+  jit_emit1(0x48);
+  jit_emit1(0x83);
+  jit_emit1(0xc4);
+  jit_emit1(0x08);
+  for (int i = 5; i >= 0; i--) {
+    jit_rex(0, 0, 0, JIT_REGS[i]);
+    jit_emit1(0x58 + (JIT_REGS[i] & 7));
+  }
+  jit_emit1(0xc3);
+}
+
+void jit_run(Module* m, int* regs, int* mem, int mem_size,
+             void (*putc_fn)(int), int (*getc_fn)(void)) {
+  jit.putc_fn = putc_fn;
+  jit.getc_fn = getc_fn;
+  jit_init(m, regs, mem, mem_size);
+  int pc = m->text->pc;
+  for (;;) {
+    if (!jit_is_valid_pc(pc))
+      jit_error("jump to outside of text", pc);
+    pc = jit.enter(jit_block(pc));
+    switch (jit.site) {
+      case JIT_EXIT_DISPATCH:
+        break;
+      case JIT_EXIT_EXIT:
+        exit(0);
+      case JIT_EXIT_LOAD:
+        jit_error("zero page load", pc);
+      case JIT_EXIT_STORE:
+        jit_error("zero page store", pc);
+      default:
+        // A direct jump to a block which was not compiled yet. Chain it.
+        jit_patch((unsigned char*)jit.site, jit_block(pc));
+    }
+  }
+}
+
+#endif  // ELVM_HAS_JIT
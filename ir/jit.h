@@ -0,0 +1,19 @@
+#ifndef ELVM_JIT_H_
+#define ELVM_JIT_H_
+
+#include <ir/ir.h>
+
+#if defined(__x86_64__) && defined(__linux__) && !defined(__eir__)
+#define ELVM_HAS_JIT
+#endif
+
+// Runs an indexed module by compiling each basic block to x86-64 code
+// the first time it is reached. Blocks jump to each other directly once
+// both are compiled; I/O and the slower extended operations call back
+// into C; PUTC and GETC go through |putc_fn| and |getc_fn|. |regs| and
+// |mem| hold the initial state, and |mem_size| words of |mem| are
+// addressable. Never returns.
+void jit_run(Module* m, int* regs, int* mem, int mem_size,
+             void (*putc_fn)(int), int (*getc_fn)(void));
+
+#endif  // ELVM_JIT_H_
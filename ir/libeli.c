@@ -0,0 +1,571 @@
+#include <ir/libeli.h>
+
+#ifdef ELVM_HAS_LIBELI
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/syscall.h>
+#endif
+
+#define ELI_MEMSZ (1 << 24)
+#define ELI_MEM_BYTES (sizeof(int) * ELI_MEMSZ)
+#define ELI_WORD_MASK (ELI_MEMSZ - 1)
+#define ELI_IN_BUFSZ 4096
+#define ELI_OUT_BUFSZ 4096
+
+// Instructions are decoded once into a flat array of handlers
+// specialized by operand kind, with immediate jump targets resolved to
+// code indices, and then dispatched with computed gotos.
+typedef enum {
+  H_MOV_REG, H_MOV_IMM, H_ADD_REG, H_ADD_IMM, H_SUB_REG, H_SUB_IMM,
+  H_LOAD_REG, H_LOAD_IMM, H_STORE_REG, H_STORE_IMM,
+  H_PUTC_REG, H_PUTC_IMM, H_GETC, H_EXIT, H_DUMP,
+  H_EQ_REG, H_EQ_IMM, H_NE_REG, H_NE_IMM, H_LT_REG, H_LT_IMM,
+  H_GT_REG, H_GT_IMM, H_LE_REG, H_LE_IMM, H_GE_REG, H_GE_IMM,
+  H_EXT_REG, H_EXT_IMM,
+  H_JEQ_REG, H_JEQ_IMM, H_JNE_REG, H_JNE_IMM, H_JLT_REG, H_JLT_IMM,
+  H_JGT_REG, H_JGT_IMM, H_JLE_REG, H_JLE_IMM, H_JGE_REG, H_JGE_IMM,
+  H_JMP, H_JMP_INDIRECT, H_JCC_INDIRECT, H_FALL_OFF, H_BAD_JUMP,
+  // Fused pairs, see threaded_fuse. For each comparison, the REG and IMM
+  // variants followed by a jump if the result is zero or nonzero.
+  H_EQ_REG_JZ, H_EQ_REG_JNZ, H_EQ_IMM_JZ, H_EQ_IMM_JNZ,
+  H_NE_REG_JZ, H_NE_REG_JNZ, H_NE_IMM_JZ, H_NE_IMM_JNZ,
+  H_LT_REG_JZ, H_LT_REG_JNZ, H_LT_IMM_JZ, H_LT_IMM_JNZ,
+  H_GT_REG_JZ, H_GT_REG_JNZ, H_GT_IMM_JZ, H_GT_IMM_JNZ,
+  H_LE_REG_JZ, H_LE_REG_JNZ, H_LE_IMM_JZ, H_LE_IMM_JNZ,
+  H_GE_REG_JZ, H_GE_REG_JNZ, H_GE_IMM_JZ, H_GE_IMM_JNZ,
+  H_MOV_ADD_REG_REG, H_MOV_ADD_REG_IMM, H_MOV_ADD_IMM_REG, H_MOV_ADD_IMM,
+  H_COUNT,
+  NUM_HANDLERS
+} Handler;
+
+typedef enum {
+  FUSE_CMP_JCC, FUSE_MOV_ADD, NUM_FUSES, NOT_FUSED = -1
+} Fuse;
+
+static const char* FUSE_NAMES[NUM_FUSES] = { "cmp+jeq/jne 0", "mov+add" };
+
+// Registers are indices, so the code can be shared by instances.
+typedef struct {
+  const void* handler;
+  int dst;
+  int src;
+  int imm;
+  // The second source of a fused pair.
+  int src2;
+  int imm2;
+  // For immediate jumps, the target pc and its code index.
+  int jmp_pc;
+  int jmp;
+  Inst* inst;
+  // With stats, |handler| counts executions and then goes to |real|.
+  const void* real;
+  long count;
+  Fuse fuse;
+} Code;
+
+struct EliModule_ {
+  Module* m;
+  Code* code;
+  bool stats;
+  // A file holding the initial memory, which instances map privately,
+  // or -1 if memory has to be copied from |m->data_words| instead.
+  int mem_fd;
+};
+
+struct EliInstance_ {
+  EliModule* em;
+  int regs[6];
+  int* mem;
+  char in[ELI_IN_BUFSZ];
+  char out[ELI_OUT_BUFSZ];
+  char error[64];
+};
+
+static int threaded_block_index(Module* m, int p) {
+  if (p < 0 || p >= m->num_blocks || m->blocks[p].start == m->num_insts)
+    return m->num_insts + 1;
+  return m->blocks[p].start;
+}
+
+static int threaded_cmp(Op op, int d, int s) {
+  switch (op) {
+    case JEQ: return d == s;
+    case JNE: return d != s;
+    case JLT: return d < s;
+    case JGT: return d > s;
+    case JLE: return d <= s;
+    case JGE: return d >= s;
+    default: return 1;
+  }
+}
+
+// Replaces common pairs of instructions within a block with one
+// handler, which then skips the second instruction. A pair never
+// straddles a jump target, as those only start blocks.
+//
+// - A comparison into R followed by "jeq/jne L, R, 0", as 8cc emits
+//   for conditions. R still gets the result.
+// - "mov R, X" followed by "add R, Y", as in address computations.
+static void threaded_fuse(Module* m, Code* code, const void** handlers) {
+  for (int i = 0; i < m->num_insts; i++)
+    code[i].fuse = NOT_FUSED;
+  for (int i = 0; i + 1 < m->num_insts; i++) {
+    Inst* a = &m->insts[i];
+    Inst* b = &m->insts[i + 1];
+    Code* c = &code[i];
+    if (a->pc != b->pc)
+      continue;
+
+    if (a->op >= EQ && a->op <= GE && (b->op == JEQ || b->op == JNE) &&
+        b->dst.reg == a->dst.reg && b->src.type == IMM && b->src.imm == 0 &&
+        b->jmp.type == IMM) {
+      int h = H_EQ_REG_JZ + (a->op - EQ) * 4;
+      if (a->src.type == IMM)
+        h += 2;
+      if (b->op == JNE)
+        h++;
+      c->handler = handlers[h];
+      c->jmp_pc = code[i + 1].jmp_pc;
+      c->jmp = code[i + 1].jmp;
+      c->fuse = FUSE_CMP_JCC;
+    } else if (a->op == MOV && b->op == ADD && b->dst.reg == a->dst.reg &&
+               !(b->src.type == REG && b->src.reg == a->dst.reg)) {
+      int h;
+      if (b->src.type == REG)
+        c->src2 = b->src.reg;
+      else
+        c->imm2 = b->src.imm;
+      if (a->src.type == REG) {
+        h = b->src.type == REG ? H_MOV_ADD_REG_REG : H_MOV_ADD_REG_IMM;
+      } else if (b->src.type == REG) {
+        h = H_MOV_ADD_IMM_REG;
+      } else {
+        h = H_MOV_ADD_IMM;
+        c->imm = (a->src.imm + b->src.imm) & ELI_WORD_MASK;
+      }
+      c->handler = handlers[h];
+      c->fuse = FUSE_MOV_ADD;
+    } else {
+      continue;
+    }
+    i++;
+  }
+}
+
+static Code* threaded_decode(Module* m, const void** handlers, bool stats) {
+  // Two sentinels follow the text: falling off its end, and the target
+  // of immediate jumps to outside of text.
+  Code* code = calloc(m->num_insts + 2, sizeof(Code));
+  for (int i = 0; i < m->num_insts; i++) {
+    Inst* inst = &m->insts[i];
+    Code* c = &code[i];
+    bool is_reg = inst->src.type == REG;
+    int h;
+    c->inst = inst;
+    c->dst = inst->dst.type == REG ? inst->dst.reg : 0;
+    if (is_reg)
+      c->src = inst->src.reg;
+    else
+      c->imm = inst->src.imm;
+
+    switch (inst->op) {
+      case MOV: h = H_MOV_REG; break;
+      case ADD: h = H_ADD_REG; break;
+      case SUB: h = H_SUB_REG; break;
+      case LOAD: h = H_LOAD_REG; break;
+      case STORE: h = H_STORE_REG; break;
+      case PUTC: h = H_PUTC_REG; break;
+      case EQ: h = H_EQ_REG; break;
+      case NE: h = H_NE_REG; break;
+      case LT: h = H_LT_REG; break;
+      case GT: h = H_GT_REG; break;
+      case LE: h = H_LE_REG; break;
+      case GE: h = H_GE_REG; break;
+      case JEQ: h = H_JEQ_REG; break;
+      case JNE: h = H_JNE_REG; break;
+      case JLT: h = H_JLT_REG; break;
+      case JGT: h = H_JGT_REG; break;
+      case JLE: h = H_JLE_REG; break;
+      case JGE: h = H_JGE_REG; break;
+      case GETC: h = H_GETC; break;
+      case EXIT: h = H_EXIT; break;
+      case DUMP: h = H_DUMP; break;
+      case JMP: h = H_JMP; break;
+      default:
+        if (!is_ext_op(inst->op)) {
+          fprintf(stderr, "oops op=%d\n", inst->op);
+          exit(1);
+        }
+        h = H_EXT_REG;
+    }
+    // Each *_IMM handler directly follows its *_REG counterpart.
+    if (h < H_GETC || (h >= H_EQ_REG && h <= H_JGE_IMM)) {
+      if (!is_reg)
+        h++;
+    }
+
+    if (inst->op >= JEQ && inst->op <= JMP) {
+      if (inst->jmp.type == REG) {
+        h = inst->op == JMP ? H_JMP_INDIRECT : H_JCC_INDIRECT;
+      } else {
+        c->jmp_pc = inst->jmp.imm;
+        c->jmp = threaded_block_index(m, c->jmp_pc);
+      }
+    }
+    c->handler = handlers[h];
+  }
+  code[m->num_insts].handler = handlers[H_FALL_OFF];
+  code[m->num_insts + 1].handler = handlers[H_BAD_JUMP];
+  threaded_fuse(m, code, handlers);
+
+  if (stats) {
+    for (int i = 0; i < m->num_insts + 2; i++) {
+      code[i].real = code[i].handler;
+      code[i].handler = handlers[H_COUNT];
+    }
+  }
+  return code;
+}
+
+#define THREADED_NEXT goto *(++c)->handler
+#define THREADED_NEXT2 do {                     \
+    c += 2;                                     \
+    goto *c->handler;                           \
+  } while (0)
+#define THREADED_JUMP(p, i) do {                \
+    pc = p;                                     \
+    c = &code[i];                               \
+    goto *c->handler;                           \
+  } while (0)
+#define THREADED_ERROR(msg) do {                \
+    err = msg;                                  \
+    goto error;                                 \
+  } while (0)
+
+#define THREADED_BINOP(name, expr)                                \
+  name##_REG: { int s = r[c->src]; expr; THREADED_NEXT; }         \
+  name##_IMM: { int s = c->imm; expr; THREADED_NEXT; }
+
+#define THREADED_JCC(name, cmp)                                         \
+  name##_REG:                                                           \
+  if (r[c->dst] cmp r[c->src]) THREADED_JUMP(c->jmp_pc, c->jmp);        \
+  THREADED_NEXT;                                                        \
+  name##_IMM:                                                           \
+  if (r[c->dst] cmp c->imm) THREADED_JUMP(c->jmp_pc, c->jmp);           \
+  THREADED_NEXT;
+
+#define THREADED_CMP_JCC(name, cmp)                                     \
+  name##_REG_JZ:                                                        \
+  if (!(r[c->dst] = r[c->dst] cmp r[c->src]))                           \
+    THREADED_JUMP(c->jmp_pc, c->jmp);                                   \
+  THREADED_NEXT2;                                                       \
+  name##_REG_JNZ:                                                       \
+  if ((r[c->dst] = r[c->dst] cmp r[c->src]))                            \
+    THREADED_JUMP(c->jmp_pc, c->jmp);                                   \
+  THREADED_NEXT2;                                                       \
+  name##_IMM_JZ:                                                        \
+  if (!(r[c->dst] = r[c->dst] cmp c->imm))                              \
+    THREADED_JUMP(c->jmp_pc, c->jmp);                                   \
+  THREADED_NEXT2;                                                       \
+  name##_IMM_JNZ:                                                       \
+  if ((r[c->dst] = r[c->dst] cmp c->imm))                               \
+    THREADED_JUMP(c->jmp_pc, c->jmp);                                   \
+  THREADED_NEXT2;
+
+// Runs |inst| until EXIT or an error. Without an instance, only decodes
+// the code of |em|, as the handler addresses are local to this function.
+static int threaded_run(EliModule* em, EliInstance* inst, const EliIO* io) {
+  static const void* handlers[NUM_HANDLERS] = {
+    &&MOV_REG, &&MOV_IMM, &&ADD_REG, &&ADD_IMM, &&SUB_REG, &&SUB_IMM,
+    &&LOAD_REG, &&LOAD_IMM, &&STORE_REG, &&STORE_IMM,
+    &&PUTC_REG, &&PUTC_IMM, &&GETC, &&EXIT, &&DUMP,
+    &&EQ_REG, &&EQ_IMM, &&NE_REG, &&NE_IMM, &&LT_REG, &&LT_IMM,
+    &&GT_REG, &&GT_IMM, &&LE_REG, &&LE_IMM, &&GE_REG, &&GE_IMM,
+    &&EXT_REG, &&EXT_IMM,
+    &&JEQ_REG, &&JEQ_IMM, &&JNE_REG, &&JNE_IMM, &&JLT_REG, &&JLT_IMM,
+    &&JGT_REG, &&JGT_IMM, &&JLE_REG, &&JLE_IMM, &&JGE_REG, &&JGE_IMM,
+    &&JMP, &&JMP_INDIRECT, &&JCC_INDIRECT, &&FALL_OFF, &&BAD_JUMP,
+    &&EQ_REG_JZ, &&EQ_REG_JNZ, &&EQ_IMM_JZ, &&EQ_IMM_JNZ,
+    &&NE_REG_JZ, &&NE_REG_JNZ, &&NE_IMM_JZ, &&NE_IMM_JNZ,
+    &&LT_REG_JZ, &&LT_REG_JNZ, &&LT_IMM_JZ, &&LT_IMM_JNZ,
+    &&GT_REG_JZ, &&GT_REG_JNZ, &&GT_IMM_JZ, &&GT_IMM_JNZ,
+    &&LE_REG_JZ, &&LE_REG_JNZ, &&LE_IMM_JZ, &&LE_IMM_JNZ,
+    &&GE_REG_JZ, &&GE_REG_JNZ, &&GE_IMM_JZ, &&GE_IMM_JNZ,
+    &&MOV_ADD_REG_REG, &&MOV_ADD_REG_IMM, &&MOV_ADD_IMM_REG, &&MOV_ADD_IMM,
+    &&COUNT,
+  };
+  if (!inst) {
+    em->code = threaded_decode(em->m, handlers, em->stats);
+    return ELI_EXIT;
+  }
+
+  Module* m = em->m;
+  Code* code = em->code;
+  int* r = inst->regs;
+  int* mem = inst->mem;
+  char* out = inst->out;
+  int out_len = 0;
+  int out_cap = io->out_bufsz;
+  int in_pos = 0;
+  int in_len = 0;
+  bool in_eof = false;
+  const char* err;
+  int pc;
+  Code* c;
+  if (out_cap < 1 || out_cap > ELI_OUT_BUFSZ)
+    out_cap = ELI_OUT_BUFSZ;
+
+  THREADED_JUMP(m->text->pc, threaded_block_index(m, m->text->pc));
+
+  THREADED_BINOP(MOV, r[c->dst] = s);
+  THREADED_BINOP(ADD, r[c->dst] = (r[c->dst] + s) & ELI_WORD_MASK);
+  THREADED_BINOP(SUB, r[c->dst] = (r[c->dst] - s) & ELI_WORD_MASK);
+  THREADED_BINOP(LOAD, {
+      if (s < 0)
+        THREADED_ERROR("zero page load");
+      r[c->dst] = mem[s];
+    });
+  THREADED_BINOP(STORE, {
+      if (s < 0)
+        THREADED_ERROR("zero page store");
+      mem[s] = r[c->dst];
+    });
+  THREADED_BINOP(PUTC, {
+      out[out_len++] = s;
+      if (out_len == out_cap) {
+        io->write(io->ctx, out, out_len);
+        out_len = 0;
+      }
+    });
+  THREADED_BINOP(EQ, r[c->dst] = r[c->dst] == s);
+  THREADED_BINOP(NE, r[c->dst] = r[c->dst] != s);
+  THREADED_BINOP(LT, r[c->dst] = r[c->dst] < s);
+  THREADED_BINOP(GT, r[c->dst] = r[c->dst] > s);
+  THREADED_BINOP(LE, r[c->dst] = r[c->dst] <= s);
+  THREADED_BINOP(GE, r[c->dst] = r[c->dst] >= s);
+  THREADED_BINOP(EXT, r[c->dst] = eval_ext_op(c->inst->op, r[c->dst], s));
+
+  THREADED_JCC(JEQ, ==);
+  THREADED_JCC(JNE, !=);
+  THREADED_JCC(JLT, <);
+  THREADED_JCC(JGT, >);
+  THREADED_JCC(JLE, <=);
+  THREADED_JCC(JGE, >=);
+
+  THREADED_CMP_JCC(EQ, ==);
+  THREADED_CMP_JCC(NE, !=);
+  THREADED_CMP_JCC(LT, <);
+  THREADED_CMP_JCC(GT, >);
+  THREADED_CMP_JCC(LE, <=);
+  THREADED_CMP_JCC(GE, >=);
+
+ MOV_ADD_REG_REG:
+  r[c->dst] = (r[c->src] + r[c->src2]) & ELI_WORD_MASK;
+  THREADED_NEXT2;
+ MOV_ADD_REG_IMM:
+  r[c->dst] = (r[c->src] + c->imm2) & ELI_WORD_MASK;
+  THREADED_NEXT2;
+ MOV_ADD_IMM_REG:
+  r[c->dst] = (c->imm + r[c->src2]) & ELI_WORD_MASK;
+  THREADED_NEXT2;
+ MOV_ADD_IMM:
+  r[c->dst] = c->imm;
+  THREADED_NEXT2;
+ COUNT:
+  c->count++;
+  goto *c->real;
+
+ GETC:
+  if (in_pos == in_len && !in_eof) {
+    if (out_len) {
+      io->write(io->ctx, out, out_len);
+      out_len = 0;
+    }
+    in_len = io->read(io->ctx, inst->in, ELI_IN_BUFSZ);
+    in_pos = 0;
+    in_eof = in_len <= 0;
+  }
+  r[c->dst] = in_pos < in_len ? (unsigned char)inst->in[in_pos++] : 0;
+  THREADED_NEXT;
+ EXIT:
+  if (out_len)
+    io->write(io->ctx, out, out_len);
+  return ELI_EXIT;
+ DUMP:
+  THREADED_NEXT;
+ JMP:
+  THREADED_JUMP(c->jmp_pc, c->jmp);
+ JMP_INDIRECT:
+ JCC_INDIRECT: {
+    Inst* i = c->inst;
+    int s = i->src.type == REG ? r[c->src] : c->imm;
+    if (threaded_cmp(i->op, r[c->dst], s)) {
+      int p = r[i->jmp.reg];
+      THREADED_JUMP(p, threaded_block_index(m, p));
+    }
+    THREADED_NEXT;
+  }
+ FALL_OFF:
+  // Like the reference interpreter, restart the block last jumped to.
+  THREADED_JUMP(pc, threaded_block_index(m, pc));
+ BAD_JUMP:
+  err = "jump to outside of text";
+ error:
+  if (out_len)
+    io->write(io->ctx, out, out_len);
+  snprintf(inst->error, sizeof(inst->error), "%s (pc=%d)", err, pc);
+  return ELI_ERROR;
+}
+
+static int libeli_memfd(void) {
+#if defined(__linux__) && defined(SYS_memfd_create)
+  return syscall(SYS_memfd_create, "eli", 0);
+#else
+  return -1;
+#endif
+}
+
+EliModule* eli_load(const char* filename) {
+  return eli_module_new(load_eir_from_file(filename), false);
+}
+
+EliModule* eli_module_new(Module* m, bool stats) {
+  EliModule* em = calloc(1, sizeof(EliModule));
+  em->m = m;
+  em->stats = stats;
+  threaded_run(em, NULL, NULL);
+
+  size_t size = sizeof(int) * m->num_data_words;
+  em->mem_fd = libeli_memfd();
+  if (em->mem_fd >= 0 &&
+      (ftruncate(em->mem_fd, ELI_MEM_BYTES) ||
+       pwrite(em->mem_fd, m->data_words, size, 0) != (ssize_t)size)) {
+    close(em->mem_fd);
+    em->mem_fd = -1;
+  }
+  return em;
+}
+
+void eli_module_free(EliModule* em) {
+  if (em->mem_fd >= 0)
+    close(em->mem_fd);
+  free(em->code);
+  free_module(em->m);
+  free(em);
+}
+
+void eli_report_stats(EliModule* em) {
+  long sites[NUM_FUSES] = {};
+  long runs[NUM_FUSES] = {};
+  long dispatches = 0;
+  long insts = 0;
+  for (int i = 0; i < em->m->num_insts; i++) {
+    Code* c = &em->code[i];
+    dispatches += c->count;
+    insts += c->count;
+    if (c->fuse != NOT_FUSED) {
+      sites[c->fuse]++;
+      runs[c->fuse] += c->count;
+      insts += c->count;
+    }
+  }
+  fprintf(stderr, "stats: %ld insts in %ld dispatches (%.1f%% fused away)\n",
+          insts, dispatches,
+          insts ? 100.0 * (insts - dispatches) / insts : 0.0);
+  for (int f = 0; f < NUM_FUSES; f++) {
+    fprintf(stderr, "  %-14s %8ld sites %12ld runs\n",
+            FUSE_NAMES[f], sites[f], runs[f]);
+  }
+}
+
+static void libeli_map_mem(EliInstance* inst) {
+  EliModule* em = inst->em;
+  int flags = MAP_PRIVATE | MAP_NORESERVE;
+  if (em->mem_fd < 0)
+    flags |= MAP_ANONYMOUS;
+  inst->mem = mmap(NULL, ELI_MEM_BYTES, PROT_READ | PROT_WRITE, flags,
+                   em->mem_fd, 0);
+  if (inst->mem == MAP_FAILED) {
+    perror("mmap");
+    exit(1);
+  }
+  if (em->mem_fd < 0) {
+    memcpy(inst->mem, em->m->data_words,
+           sizeof(int) * em->m->num_data_words);
+  }
+}
+
+EliInstance* eli_instance_new(EliModule* em) {
+  EliInstance* inst = calloc(1, sizeof(EliInstance));
+  inst->em = em;
+  libeli_map_mem(inst);
+  return inst;
+}
+
+void eli_instance_free(EliInstance* inst) {
+  munmap(inst->mem, ELI_MEM_BYTES);
+  free(inst);
+}
+
+void eli_reset(EliInstance* inst) {
+  memset(inst->regs, 0, sizeof(inst->regs));
+  inst->error[0] = 0;
+  if (inst->em->mem_fd >= 0) {
+    // Drops the private copies of written pages, so they read from the
+    // initial image again.
+    madvise(inst->mem, ELI_MEM_BYTES, MADV_DONTNEED);
+  } else {
+    munmap(inst->mem, ELI_MEM_BYTES);
+    libeli_map_mem(inst);
+  }
+}
+
+const char* eli_error(EliInstance* inst) {
+  return inst->error;
+}
+
+int eli_run_io(EliInstance* inst, const EliIO* io) {
+  return threaded_run(inst->em, inst, io);
+}
+
+typedef struct {
+  const char* in;
+  size_t in_len;
+  EliBuffer* out;
+} LibeliBufferIO;
+
+static int libeli_buffer_read(void* ctx, char* buf, int cap) {
+  LibeliBufferIO* b = ctx;
+  int n = b->in_len < (size_t)cap ? (int)b->in_len : cap;
+  memcpy(buf, b->in, n);
+  b->in += n;
+  b->in_len -= n;
+  return n;
+}
+
+static void libeli_buffer_write(void* ctx, const char* buf, int len) {
+  EliBuffer* out = ((LibeliBufferIO*)ctx)->out;
+  if (out->len + len > out->cap) {
+    out->cap = out->cap * 2 + len;
+    out->data = realloc(out->data, out->cap);
+  }
+  memcpy(out->data + out->len, buf, len);
+  out->len += len;
+}
+
+int eli_run(EliInstance* inst, const char* in, size_t in_len,
+            EliBuffer* out) {
+  LibeliBufferIO b = { in, in_len, out };
+  EliIO io = {
+    libeli_buffer_read, libeli_buffer_write, &b, ELI_OUT_BUFSZ
+  };
+  return eli_run_io(inst, &io);
+}
+
+#endif  // ELVM_HAS_LIBELI
@@ -0,0 +1,75 @@
+#ifndef ELVM_LIBELI_H_
+#define ELVM_LIBELI_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include <ir/ir.h>
+
+#if defined(__GNUC__) && !defined(__eir__)
+#define ELVM_HAS_LIBELI
+#endif
+
+// An embeddable EIR interpreter. A module is decoded once into threaded
+// code and then run by any number of instances, each with its own
+// registers and memory. Instances share the module's initial memory
+// image copy-on-write, so eli_reset only discards the pages a run wrote.
+// Instances of one module may run on different threads at once, unless
+// the module counts stats.
+//
+// Only available natively, as it dispatches with computed gotos.
+
+typedef struct EliModule_ EliModule;
+typedef struct EliInstance_ EliInstance;
+
+// Output of eli_run. |data| is malloc'ed and grows as needed; a run
+// appends to it.
+typedef struct {
+  char* data;
+  size_t len;
+  size_t cap;
+} EliBuffer;
+
+// Streams for eli_run_io. |read| stores up to |cap| bytes and returns
+// how many, or 0 at EOF. Output is passed to |write| in chunks of at
+// most |out_bufsz| bytes, and always before |read| is called.
+typedef struct {
+  int (*read)(void* ctx, char* buf, int cap);
+  void (*write)(void* ctx, const char* buf, int len);
+  void* ctx;
+  int out_bufsz;
+} EliIO;
+
+enum {
+  ELI_EXIT, ELI_ERROR
+};
+
+// Loads an EIR or eirb file. Exits on errors like load_eir_from_file.
+EliModule* eli_load(const char* filename);
+
+// Takes ownership of an indexed module. With |stats|, every dispatch is
+// counted for eli_report_stats.
+EliModule* eli_module_new(Module* m, bool stats);
+
+void eli_module_free(EliModule* em);
+
+// Prints how often fused instruction pairs ran to stderr.
+void eli_report_stats(EliModule* em);
+
+EliInstance* eli_instance_new(EliModule* em);
+
+void eli_instance_free(EliInstance* inst);
+
+// Runs a new or reset instance until EXIT, with |in| as its whole input.
+// Returns ELI_EXIT, or ELI_ERROR with the reason in eli_error.
+int eli_run(EliInstance* inst, const char* in, size_t in_len, EliBuffer* out);
+
+int eli_run_io(EliInstance* inst, const EliIO* io);
+
+// Restores the registers and memory of a new instance.
+void eli_reset(EliInstance* inst);
+
+// The error of the last run, as "<message> (pc=<pc>)".
+const char* eli_error(EliInstance* inst);
+
+#endif  // ELVM_LIBELI_H_
@@ -0,0 +1,186 @@
+#include <ir/ir.h>
+
+// There is no mmap to speak of on ELVM itself.
+#ifndef __eir__
+
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <ir/arena.h>
+#include <ir/eirb.h>
+
+typedef struct {
+  const char* filename;
+  const unsigned char* p;
+  const unsigned char* end;
+} EirbReader;
+
+#ifdef __GNUC__
+__attribute__((noreturn))
+#endif
+static void eirb_error(EirbReader* r, const char* msg) {
+  fprintf(stderr, "%s: %s\n", r->filename, msg);
+  exit(1);
+}
+
+static void eirb_need(EirbReader* r, size_t words) {
+  if ((size_t)(r->end - r->p) / 4 < words)
+    eirb_error(r, "truncated binary EIR");
+}
+
+static uint32_t eirb_word(EirbReader* r) {
+  const unsigned char* p = r->p;
+  r->p += 4;
+  return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static void eirb_value(EirbReader* r, Value* v, uint32_t types, int n) {
+  uint32_t w = eirb_word(r);
+  v->type = (types >> n) & 1 ? IMM : REG;
+  v->label = (types >> (3 + n * 2)) & 3;
+  if (v->label > DATA_LABEL || w > (v->type == REG ? SP : UINT_MAX))
+    eirb_error(r, "broken binary EIR");
+  v->imm = w;
+}
+
+// Reads a string, see eirb.h.
+static char* eirb_read_string(EirbReader* r, Arena* arena) {
+  eirb_need(r, 1);
+  uint32_t len = eirb_word(r);
+  if (len >= (size_t)(r->end - r->p))
+    eirb_error(r, "truncated binary EIR");
+  eirb_need(r, ((size_t)len + 4) / 4);
+  if (r->p[len])
+    eirb_error(r, "broken binary EIR");
+  char* s = arena_alloc(arena, (size_t)len + 1);
+  memcpy(s, r->p, len + 1);
+  r->p += ((size_t)len + 4) / 4 * 4;
+  return s;
+}
+
+Module* load_eir_binary(const char* filename) {
+  int fd = open(filename, O_RDONLY);
+  struct stat st;
+  if (fd < 0 || fstat(fd, &st) < 0) {
+    fprintf(stderr, "no such file: %s\n", filename);
+    exit(1);
+  }
+  void* mapped = NULL;
+  if (st.st_size) {
+    mapped = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (mapped == MAP_FAILED) {
+      perror("mmap");
+      exit(1);
+    }
+  }
+  close(fd);
+
+  EirbReader r = {
+    .filename = filename,
+    .p = mapped,
+    .end = (const unsigned char*)mapped + st.st_size
+  };
+  eirb_need(&r, EIRB_HEADER_WORDS);
+  if (memcmp(r.p, EIRB_MAGIC, 4))
+    eirb_error(&r, "not a binary EIR");
+  r.p += 4;
+  if (eirb_word(&r) != EIRB_VERSION)
+    eirb_error(&r, "unsupported binary EIR version");
+  uint32_t num_insts = eirb_word(&r);
+  uint32_t num_data = eirb_word(&r);
+  uint32_t num_syms = eirb_word(&r);
+  uint32_t num_files = eirb_word(&r);
+  uint32_t num_locs = eirb_word(&r);
+  uint32_t num_magics = eirb_word(&r);
+  if (!num_insts || !num_data)
+    eirb_error(&r, "empty binary EIR");
+  // Every file name takes at least one word, and loc pairs two.
+  eirb_need(&r, (size_t)num_files + (size_t)num_locs * 2);
+
+  Module* m = calloc(1, sizeof(Module));
+  m->arena = arena_new();
+
+  const char** files = arena_alloc(m->arena, sizeof(char*) * num_files);
+  for (uint32_t i = 0; i < num_files; i++)
+    files[i] = eirb_read_string(&r, m->arena);
+  eirb_need(&r, (size_t)num_locs * 2);
+  SrcLoc* locs = arena_alloc(m->arena, sizeof(SrcLoc) * num_locs);
+  for (uint32_t i = 0; i < num_locs; i++) {
+    locs[i].line = eirb_word(&r);
+    uint32_t file = eirb_word(&r);
+    if (file > num_files)
+      eirb_error(&r, "broken binary EIR");
+    locs[i].file = file ? files[file - 1] : NULL;
+  }
+
+  eirb_need(&r, (size_t)num_insts * EIRB_INST_WORDS + (size_t)num_data * 2);
+
+  Inst* text = arena_alloc(m->arena, sizeof(Inst) * num_insts);
+  uint32_t pc = 0;
+  for (uint32_t i = 0; i < num_insts; i++) {
+    Inst* inst = &text[i];
+    inst->op = eirb_word(&r);
+    if ((uint32_t)inst->op >= LAST_OP)
+      eirb_error(&r, "broken binary EIR");
+    uint32_t types = eirb_word(&r);
+    eirb_value(&r, &inst->dst, types, 0);
+    eirb_value(&r, &inst->src, types, 1);
+    eirb_value(&r, &inst->jmp, types, 2);
+    uint32_t next_pc = eirb_word(&r);
+    if (next_pc < pc || next_pc > UINT_MAX)
+      eirb_error(&r, "broken binary EIR");
+    pc = next_pc;
+    inst->pc = pc;
+    inst->lineno = (int)eirb_word(&r) - 1;
+    uint32_t loc = eirb_word(&r);
+    if (loc > num_locs)
+      eirb_error(&r, "broken binary EIR");
+    inst->loc = loc ? &locs[loc - 1] : NULL;
+    inst->next = i + 1 < num_insts ? &text[i + 1] : NULL;
+  }
+  m->text = text;
+
+  Data* data = arena_alloc(m->arena, sizeof(Data) * num_data);
+  for (uint32_t i = 0; i < num_data; i++) {
+    uint32_t v = eirb_word(&r);
+    data[i].v = v;
+    data[i].label = eirb_word(&r);
+    if (v > UINT_MAX || (uint32_t)data[i].label > DATA_LABEL)
+      eirb_error(&r, "broken binary EIR");
+    data[i].next = i + 1 < num_data ? &data[i + 1] : NULL;
+  }
+  m->data = data;
+
+  Sym sym_root = {};
+  Sym* sym = &sym_root;
+  for (uint32_t i = 0; i < num_syms; i++) {
+    eirb_need(&r, 3);
+    Sym* s = arena_alloc(m->arena, sizeof(Sym));
+    s->value = eirb_word(&r);
+    s->is_text = eirb_word(&r);
+    s->name = eirb_read_string(&r, m->arena);
+    sym->next = s;
+    sym = s;
+  }
+  m->syms = sym_root.next;
+
+  for (uint32_t i = 0; i < num_magics; i++) {
+    eirb_need(&r, 1);
+    uint32_t index = eirb_word(&r);
+    if (index >= num_insts)
+      eirb_error(&r, "broken binary EIR");
+    text[index].magic_comment = eirb_read_string(&r, m->arena);
+  }
+
+  if (mapped)
+    munmap(mapped, st.st_size);
+  index_module(m);
+  return m;
+}
+
+#endif  // !__eir__
@@ -0,0 +1,351 @@
+#include <ir/lower.h>
+
+#include <stdbool.h>
+#include <stdlib.h>
+
+#include <ir/arena.h>
+#include <ir/cfg.h>
+
+// The scratch words hold A ... SP while a lowered operation runs.
+#define LOWER_SCRATCH_WORDS 6
+#define LOWER_MAX_LABELS 4
+#define LOWER_MAX_FIXUPS 8
+#define LOWER_TOP_BIT 0x800000
+
+// Builds the new text. |pc| is the pc being filled and |len| the
+// number of instructions in it so far. Jumps of a lowered operation
+// refer to |labels| by index until lower_fixup resolves them.
+typedef struct {
+  Module* m;
+  Inst root;
+  Inst* last;
+  int pc;
+  int len;
+  int scratch;
+  int lineno;
+  int labels[LOWER_MAX_LABELS];
+  Inst* fixups[LOWER_MAX_FIXUPS];
+  int num_fixups;
+} Lower;
+
+static void lower_add(Lower* l, Inst* inst) {
+  inst->pc = l->pc;
+  l->last->next = inst;
+  l->last = inst;
+  l->len++;
+  bool ends_block = inst->op >= JEQ && inst->op <= JMP;
+  if (is_basic_block_split_by_mem() &&
+      (inst->op == LOAD || inst->op == STORE))
+    ends_block = true;
+  if (ends_block) {
+    l->pc++;
+    l->len = 0;
+  }
+}
+
+static Inst* lower_new(Lower* l, Op op, Reg dst) {
+  Inst* inst = arena_alloc(l->m->arena, sizeof(Inst));
+  inst->op = op;
+  inst->dst.type = REG;
+  inst->dst.reg = dst;
+  inst->lineno = l->lineno;
+  return inst;
+}
+
+static void lower_emit_reg(Lower* l, Op op, Reg dst, Reg src) {
+  Inst* inst = lower_new(l, op, dst);
+  inst->src.type = REG;
+  inst->src.reg = src;
+  lower_add(l, inst);
+}
+
+static void lower_emit_imm(Lower* l, Op op, Reg dst, int imm) {
+  Inst* inst = lower_new(l, op, dst);
+  inst->src.type = IMM;
+  inst->src.imm = imm;
+  lower_add(l, inst);
+}
+
+static void lower_emit_value(Lower* l, Op op, Reg dst, Value* src) {
+  Inst* inst = lower_new(l, op, dst);
+  inst->src = *src;
+  lower_add(l, inst);
+}
+
+static void lower_jump_to(Lower* l, Inst* inst, int label) {
+  inst->jmp.type = IMM;
+  inst->jmp.label = TEXT_LABEL;
+  inst->jmp.imm = label;
+  l->fixups[l->num_fixups++] = inst;
+  lower_add(l, inst);
+}
+
+// Jumps to |label| if |dst| op |src|.
+static void lower_jump_reg(Lower* l, Op op, int label, Reg dst, Reg src) {
+  Inst* inst = lower_new(l, op, dst);
+  inst->src.type = REG;
+  inst->src.reg = src;
+  lower_jump_to(l, inst, label);
+}
+
+static void lower_jump_imm(Lower* l, Op op, int label, Reg dst, int imm) {
+  Inst* inst = lower_new(l, op, dst);
+  inst->src.type = IMM;
+  inst->src.imm = imm;
+  lower_jump_to(l, inst, label);
+}
+
+static void lower_goto(Lower* l, int label) {
+  lower_jump_to(l, lower_new(l, JMP, A), label);
+}
+
+static void lower_label(Lower* l, int label) {
+  if (l->len) {
+    l->pc++;
+    l->len = 0;
+  }
+  l->labels[label] = l->pc;
+}
+
+static void lower_fixup(Lower* l) {
+  for (int i = 0; i < l->num_fixups; i++) {
+    Inst* inst = l->fixups[i];
+    inst->jmp.imm = l->labels[inst->jmp.imm];
+  }
+  l->num_fixups = 0;
+}
+
+// A = B * C, shifting C left and adding B for each set bit.
+static void lower_mul(Lower* l) {
+  lower_emit_imm(l, MOV, A, 0);
+  lower_emit_imm(l, MOV, D, 24);
+  lower_label(l, 0);
+  lower_emit_reg(l, ADD, A, A);
+  lower_jump_imm(l, JLT, 1, C, LOWER_TOP_BIT);
+  lower_emit_reg(l, ADD, A, B);
+  lower_label(l, 1);
+  lower_emit_reg(l, ADD, C, C);
+  lower_emit_imm(l, SUB, D, 1);
+  lower_jump_imm(l, JNE, 0, D, 0);
+}
+
+// A = B / C and D = B % C by long division. SP keeps the remainder
+// before doubling, as doubling may carry out of the word.
+static void lower_div(Lower* l) {
+  lower_emit_imm(l, MOV, A, 0);
+  lower_emit_imm(l, MOV, D, 0);
+  lower_emit_imm(l, MOV, BP, 24);
+  lower_label(l, 0);
+  lower_emit_reg(l, ADD, A, A);
+  lower_emit_reg(l, MOV, SP, D);
+  lower_emit_reg(l, ADD, D, D);
+  lower_jump_imm(l, JLT, 1, B, LOWER_TOP_BIT);
+  lower_emit_imm(l, ADD, D, 1);
+  lower_label(l, 1);
+  lower_emit_reg(l, ADD, B, B);
+  lower_jump_imm(l, JGE, 2, SP, LOWER_TOP_BIT);
+  lower_jump_reg(l, JLT, 3, D, C);
+  lower_label(l, 2);
+  lower_emit_reg(l, SUB, D, C);
+  lower_emit_imm(l, ADD, A, 1);
+  lower_label(l, 3);
+  lower_emit_imm(l, SUB, BP, 1);
+  lower_jump_imm(l, JNE, 0, BP, 0);
+}
+
+// A = B op C one bit at a time from the top, with BP counting the set
+// bits for XOR.
+static void lower_bitwise(Lower* l, Op op) {
+  lower_emit_imm(l, MOV, A, 0);
+  lower_emit_imm(l, MOV, D, 24);
+  lower_label(l, 0);
+  lower_emit_reg(l, ADD, A, A);
+  if (op == AND) {
+    lower_jump_imm(l, JLT, 1, B, LOWER_TOP_BIT);
+    lower_jump_imm(l, JLT, 1, C, LOWER_TOP_BIT);
+  } else if (op == OR) {
+    lower_jump_imm(l, JGE, 2, B, LOWER_TOP_BIT);
+    lower_jump_imm(l, JLT, 1, C, LOWER_TOP_BIT);
+    lower_label(l, 2);
+  } else {
+    lower_emit_imm(l, MOV, BP, 0);
+    lower_jump_imm(l, JLT, 2, B, LOWER_TOP_BIT);
+    lower_emit_imm(l, ADD, BP, 1);
+    lower_label(l, 2);
+    lower_jump_imm(l, JLT, 3, C, LOWER_TOP_BIT);
+    lower_emit_imm(l, ADD, BP, 1);
+    lower_label(l, 3);
+    lower_jump_imm(l, JNE, 1, BP, 1);
+  }
+  lower_emit_imm(l, ADD, A, 1);
+  lower_label(l, 1);
+  lower_emit_reg(l, ADD, B, B);
+  lower_emit_reg(l, ADD, C, C);
+  lower_emit_imm(l, SUB, D, 1);
+  lower_jump_imm(l, JNE, 0, D, 0);
+}
+
+// A = B << C by doubling.
+static void lower_shl(Lower* l) {
+  lower_emit_imm(l, MOV, A, 0);
+  lower_jump_imm(l, JGE, 1, C, 24);
+  lower_emit_reg(l, MOV, A, B);
+  lower_label(l, 0);
+  lower_jump_imm(l, JEQ, 1, C, 0);
+  lower_emit_reg(l, ADD, A, A);
+  lower_emit_imm(l, SUB, C, 1);
+  lower_goto(l, 0);
+  lower_label(l, 1);
+}
+
+// A = B >> C by collecting the top 24 - C bits of B.
+static void lower_shr(Lower* l) {
+  lower_emit_imm(l, MOV, A, 0);
+  lower_jump_imm(l, JGE, 2, C, 24);
+  lower_emit_imm(l, MOV, D, 24);
+  lower_emit_reg(l, SUB, D, C);
+  lower_label(l, 0);
+  lower_emit_reg(l, ADD, A, A);
+  lower_jump_imm(l, JLT, 1, B, LOWER_TOP_BIT);
+  lower_emit_imm(l, ADD, A, 1);
+  lower_label(l, 1);
+  lower_emit_reg(l, ADD, B, B);
+  lower_emit_imm(l, SUB, D, 1);
+  lower_jump_imm(l, JNE, 0, D, 0);
+  lower_label(l, 2);
+}
+
+// Loads a scratch word into |r|. Some targets (bf) only load into A.
+static void lower_load(Lower* l, Reg r, int addr) {
+  lower_emit_imm(l, LOAD, A, addr);
+  if (r != A)
+    lower_emit_reg(l, MOV, r, A);
+}
+
+// Saves all registers, runs the loop on B = dst and C = src, and
+// reloads the registers with the result in place of dst.
+static void lower_ext_inst(Lower* l, Inst* inst) {
+  Reg d = inst->dst.reg;
+  l->lineno = inst->lineno;
+  for (int r = 0; r < LOWER_SCRATCH_WORDS; r++)
+    lower_emit_imm(l, STORE, (Reg)r, l->scratch + r);
+  lower_load(l, B, l->scratch + d);
+  if (inst->src.type == REG)
+    lower_load(l, C, l->scratch + inst->src.reg);
+  else
+    lower_emit_value(l, MOV, C, &inst->src);
+
+  Reg result = A;
+  switch (inst->op) {
+    case MUL:
+      lower_mul(l);
+      break;
+    case DIV:
+    case MOD:
+      lower_div(l);
+      if (inst->op == MOD)
+        result = D;
+      break;
+    case AND:
+    case OR:
+    case XOR:
+      lower_bitwise(l, inst->op);
+      break;
+    case SHL:
+      lower_shl(l);
+      break;
+    case SHR:
+      lower_shr(l);
+      break;
+    default:
+      break;
+  }
+  lower_fixup(l);
+
+  lower_emit_imm(l, STORE, result, l->scratch + d);
+  for (int r = LOWER_SCRATCH_WORDS - 1; r >= 0; r--)
+    lower_load(l, (Reg)r, l->scratch + r);
+}
+
+static void lower_remap_pc(Value* v, int* new_pc, int num_blocks, int n) {
+  if (v->type != IMM || v->label != TEXT_LABEL || v->imm < 0)
+    return;
+  if (v->imm >= num_blocks)
+    v->imm += n - num_blocks;
+  else
+    v->imm = new_pc[v->imm];
+}
+
+void lower_ext_ops(Module* m) {
+  bool found = false;
+  for (int i = 0; i < m->num_insts; i++) {
+    if (is_ext_op(m->insts[i].op))
+      found = true;
+  }
+  if (!found)
+    return;
+
+  if (has_numeric_code_addrs(m)) {
+    fprintf(stderr, "cannot lower extended ops with numeric code addresses\n");
+    exit(1);
+  }
+  Data* edata = NULL;
+  for (Data* d = m->data; d; d = d->next)
+    edata = d;
+  if (!edata || edata->v != m->num_data_words) {
+    fprintf(stderr, "cannot lower extended ops without _edata\n");
+    exit(1);
+  }
+
+  Lower l = {};
+  l.m = m;
+  l.last = &l.root;
+  l.scratch = edata->v;
+  edata->v += LOWER_SCRATCH_WORDS;
+
+  int* new_pc = malloc(sizeof(int) * (m->num_blocks + 1));
+  for (int pc = 0; pc < m->num_blocks; pc++) {
+    if (l.len) {
+      l.pc++;
+      l.len = 0;
+    }
+    new_pc[pc] = l.pc;
+    BasicBlock* bb = &m->blocks[pc];
+    for (int i = bb->start; i < bb->start + bb->len; i++) {
+      Inst* inst = &m->insts[i];
+      if (is_ext_op(inst->op))
+        lower_ext_inst(&l, inst);
+      else
+        lower_add(&l, inst);
+    }
+  }
+  l.last->next = NULL;
+  int n = l.pc + (l.len ? 1 : 0);
+
+  for (int i = 0; i < m->num_insts; i++) {
+    Inst* inst = &m->insts[i];
+    lower_remap_pc(&inst->dst, new_pc, m->num_blocks, n);
+    lower_remap_pc(&inst->src, new_pc, m->num_blocks, n);
+    lower_remap_pc(&inst->jmp, new_pc, m->num_blocks, n);
+  }
+  for (Data* d = m->data; d; d = d->next) {
+    if (d->label != TEXT_LABEL || d->v < 0)
+      continue;
+    if (d->v >= m->num_blocks)
+      d->v += n - m->num_blocks;
+    else
+      d->v = new_pc[d->v];
+  }
+  for (Sym* sym = m->syms; sym; sym = sym->next) {
+    if (!sym->is_text || sym->value < 0)
+      continue;
+    if (sym->value >= m->num_blocks)
+      sym->value += n - m->num_blocks;
+    else
+      sym->value = new_pc[sym->value];
+  }
+  free(new_pc);
+
+  m->text = l.root.next;
+  index_module(m);
+}
@@ -0,0 +1,15 @@
+#ifndef ELVM_LOWER_H_
+#define ELVM_LOWER_H_
+
+#include <ir/ir.h>
+
+// Rewrites the extended operations (MUL ... SHR) of an indexed module
+// into loops of core operations, for targets which cannot run them.
+// Each one saves all registers to scratch words reserved right after
+// the data segment, so the heap _edata points to starts a little later.
+// New pcs are inserted for the loops and text labels are remapped, so
+// modules whose code addresses may be plain numbers (see
+// has_numeric_code_addrs) are rejected.
+void lower_ext_ops(Module* m);
+
+#endif  // ELVM_LOWER_H_
@@ -0,0 +1,876 @@
+#include <ir/opt.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <ir/cfg.h>
+
+// All passes here are block-local unless noted otherwise. A pass marks
+// instructions in |dead| and opt_sweep unlinks them afterwards. Only
+// opt_merge_blocks renumbers pcs, and it relies on Value.label and
+// Data.label to find every code address.
+
+typedef struct {
+  Module* m;
+  bool* dead;
+} Opt;
+
+static bool opt_is_cmp(Op op) {
+  return op >= EQ && op <= GE;
+}
+
+static bool opt_is_cond_jump(Op op) {
+  return op >= JEQ && op <= JGE;
+}
+
+static bool opt_eval_cmp(Op op, int d, int s) {
+  if (op >= EQ)
+    op -= 8;
+  switch (op) {
+    case JEQ: return d == s;
+    case JNE: return d != s;
+    case JLT: return d < s;
+    case JGT: return d > s;
+    case JLE: return d <= s;
+    case JGE: return d >= s;
+    default: return true;
+  }
+}
+
+static void opt_set_imm(Value* v, int imm) {
+  v->type = IMM;
+  v->label = NO_LABEL;
+  v->imm = imm;
+}
+
+static void opt_set_label(Value* v, int imm, LabelKind label) {
+  opt_set_imm(v, imm);
+  v->label = label;
+}
+
+static void opt_set_mov(Inst* inst, int imm) {
+  inst->op = MOV;
+  opt_set_imm(&inst->src, imm);
+}
+
+// Unlinks dead instructions and reindexes the module. The last
+// instruction of a block is kept if everything else in it is dead, as
+// backends expect every pc to have code. Every pass only marks
+// instructions whose removal leaves the rest of the block correct, so
+// keeping one of them is harmless.
+static int opt_sweep(Opt* o) {
+  Module* m = o->m;
+  Inst root = {};
+  Inst* last = &root;
+  int removed = 0;
+  for (int pc = 0; pc < m->num_blocks; pc++) {
+    BasicBlock* bb = &m->blocks[pc];
+    int alive = 0;
+    for (int i = bb->start; i < bb->start + bb->len; i++) {
+      if (!o->dead[i])
+        alive++;
+    }
+    if (bb->len && !alive)
+      o->dead[bb->start + bb->len - 1] = false;
+    for (int i = bb->start; i < bb->start + bb->len; i++) {
+      if (o->dead[i]) {
+        removed++;
+        continue;
+      }
+      last->next = &m->insts[i];
+      last = last->next;
+    }
+  }
+  last->next = NULL;
+  m->text = root.next;
+  free(o->dead);
+  index_module(m);
+  return removed;
+}
+
+static void opt_begin(Opt* o, Module* m) {
+  o->m = m;
+  o->dead = calloc(m->num_insts + 1, sizeof(bool));
+}
+
+// Constant propagation and folding. Registers with a known value are
+// replaced by immediates, arithmetic and comparisons on known values
+// become moves, and conditional jumps with a known outcome become
+// unconditional or disappear. Labels are propagated but never folded,
+// as their values may change when code or data moves.
+static void opt_fold_consts(Module* m) {
+  Opt o;
+  opt_begin(&o, m);
+  for (int pc = 0; pc < m->num_blocks; pc++) {
+    bool known[6] = {};
+    int vals[6];
+    LabelKind labels[6];
+    BasicBlock* bb = &m->blocks[pc];
+    for (int i = bb->start; i < bb->start + bb->len; i++) {
+      Inst* inst = &m->insts[i];
+      Op op = inst->op;
+      if (op != GETC && op != EXIT && op != DUMP && op != JMP) {
+        Reg r = inst->src.reg;
+        if (inst->src.type == REG && known[r])
+          opt_set_label(&inst->src, vals[r], labels[r]);
+      }
+      if (inst->jmp.type == REG && known[inst->jmp.reg] &&
+          (op == JMP || opt_is_cond_jump(op))) {
+        Reg r = inst->jmp.reg;
+        opt_set_label(&inst->jmp, vals[r], labels[r]);
+      }
+
+      Reg d = inst->dst.reg;
+      bool foldable = inst->src.type == IMM && known[d] &&
+          inst->src.label == NO_LABEL && labels[d] == NO_LABEL;
+      switch (op) {
+        case MOV:
+          if (inst->src.type == IMM) {
+            if (known[d] && vals[d] == inst->src.imm &&
+                labels[d] == inst->src.label)
+              o.dead[i] = true;
+            known[d] = true;
+            vals[d] = inst->src.imm;
+            labels[d] = inst->src.label;
+          } else if (inst->src.reg == d) {
+            o.dead[i] = true;
+          } else {
+            known[d] = false;
+          }
+          break;
+
+        case ADD:
+        case SUB:
+          if (inst->src.type == IMM && inst->src.imm == 0 &&
+              inst->src.label == NO_LABEL) {
+            o.dead[i] = true;
+          } else if (foldable) {
+            int v = op == ADD ? vals[d] + inst->src.imm
+                : vals[d] - inst->src.imm;
+            vals[d] = MOD24((v));
+            opt_set_mov(inst, vals[d]);
+          } else {
+            known[d] = false;
+          }
+          break;
+
+        case EQ:
+        case NE:
+        case LT:
+        case GT:
+        case LE:
+        case GE:
+          if (foldable) {
+            vals[d] = opt_eval_cmp(op, vals[d], inst->src.imm);
+            opt_set_mov(inst, vals[d]);
+          } else {
+            known[d] = false;
+          }
+          break;
+
+        case MUL:
+        case DIV:
+        case MOD:
+        case AND:
+        case OR:
+        case XOR:
+        case SHL:
+        case SHR:
+          if (foldable) {
+            vals[d] = eval_ext_op(op, vals[d], inst->src.imm);
+            opt_set_mov(inst, vals[d]);
+          } else {
+            known[d] = false;
+          }
+          break;
+
+        case LOAD:
+        case GETC:
+          known[d] = false;
+          break;
+
+        case JEQ:
+        case JNE:
+        case JLT:
+        case JGT:
+        case JLE:
+        case JGE:
+          if (foldable) {
+            if (opt_eval_cmp(op, vals[d], inst->src.imm)) {
+              inst->op = JMP;
+              memset(&inst->dst, 0, sizeof(Value));
+              memset(&inst->src, 0, sizeof(Value));
+            } else {
+              o.dead[i] = true;
+            }
+          }
+          break;
+
+        default:
+          break;
+      }
+    }
+  }
+  opt_sweep(&o);
+}
+
+static void opt_kill_copies(int* copies, int r) {
+  copies[r] = -1;
+  for (int i = 0; i < 6; i++) {
+    if (copies[i] == r)
+      copies[i] = -1;
+  }
+}
+
+static void opt_copy_reg(int* copies, Value* v) {
+  if (v->type == REG && copies[v->reg] >= 0)
+    v->reg = copies[v->reg];
+}
+
+// Copy propagation. After `mov B, A`, reads of B become reads of A for
+// as long as both keep their values, which leaves the move dead more
+// often than not.
+static void opt_propagate_copies(Module* m) {
+  Opt o;
+  opt_begin(&o, m);
+  for (int pc = 0; pc < m->num_blocks; pc++) {
+    int copies[6] = { -1, -1, -1, -1, -1, -1 };
+    BasicBlock* bb = &m->blocks[pc];
+    for (int i = bb->start; i < bb->start + bb->len; i++) {
+      Inst* inst = &m->insts[i];
+      Op op = inst->op;
+      if (op == EXIT || op == DUMP)
+        continue;
+      if (op != GETC && op != JMP)
+        opt_copy_reg(copies, &inst->src);
+      if (op == STORE || opt_is_cond_jump(op))
+        opt_copy_reg(copies, &inst->dst);
+      if (op == JMP || opt_is_cond_jump(op))
+        opt_copy_reg(copies, &inst->jmp);
+
+      int use, def;
+      inst_use_def(inst, &use, &def);
+      if (!def)
+        continue;
+      int d = inst->dst.reg;
+      if (op == MOV && inst->src.type == REG) {
+        int s = inst->src.reg;
+        if (s == d) {
+          o.dead[i] = true;
+          continue;
+        }
+        opt_kill_copies(copies, d);
+        copies[d] = s;
+      } else {
+        opt_kill_copies(copies, d);
+      }
+    }
+  }
+  opt_sweep(&o);
+}
+
+// A register known to hold the word at an address, where the address is
+// either an immediate or the current value of a register.
+typedef struct {
+  Value addr;
+  Reg reg;
+} OptMemVal;
+
+#define OPT_MAX_MEM_VALS 16
+
+static bool opt_same_value(Value* a, Value* b) {
+  if (a->type != b->type)
+    return false;
+  return a->type == REG ? a->reg == b->reg : a->imm == b->imm;
+}
+
+static int opt_find_mem_val(OptMemVal* vals, int n, Value* addr) {
+  for (int i = 0; i < n; i++) {
+    if (opt_same_value(&vals[i].addr, addr))
+      return i;
+  }
+  return -1;
+}
+
+// Forgets everything that depended on the old value of register |r|.
+static int opt_kill_mem_reg(OptMemVal* vals, int n, Reg r) {
+  int j = 0;
+  for (int i = 0; i < n; i++) {
+    if (vals[i].reg == r ||
+        (vals[i].addr.type == REG && vals[i].addr.reg == r))
+      continue;
+    vals[j++] = vals[i];
+  }
+  return j;
+}
+
+// Forgets every address which may alias |addr|.
+static int opt_kill_mem_alias(OptMemVal* vals, int n, Value* addr) {
+  int j = 0;
+  for (int i = 0; i < n; i++) {
+    if (addr->type == REG || vals[i].addr.type == REG ||
+        vals[i].addr.imm == addr->imm)
+      continue;
+    vals[j++] = vals[i];
+  }
+  return j;
+}
+
+static int opt_add_mem_val(OptMemVal* vals, int n, Value* addr, Reg reg) {
+  if (addr->type == REG && addr->reg == reg)
+    return n;
+  if (n == OPT_MAX_MEM_VALS) {
+    for (int i = 1; i < n; i++)
+      vals[i - 1] = vals[i];
+    n--;
+  }
+  vals[n].addr = *addr;
+  vals[n].reg = reg;
+  return n + 1;
+}
+
+// Redundant load/store elimination. A load from an address whose value
+// is already in a register becomes a move, and a store of the value an
+// address already holds is dropped. Stores through a register are
+// assumed to alias everything. Loads and stores are never reordered.
+static void opt_eliminate_mem(Module* m) {
+  Opt o;
+  opt_begin(&o, m);
+  for (int pc = 0; pc < m->num_blocks; pc++) {
+    OptMemVal vals[OPT_MAX_MEM_VALS];
+    int n = 0;
+    BasicBlock* bb = &m->blocks[pc];
+    for (int i = bb->start; i < bb->start + bb->len; i++) {
+      Inst* inst = &m->insts[i];
+      Reg d = inst->dst.reg;
+      if (inst->op == LOAD) {
+        int found = opt_find_mem_val(vals, n, &inst->src);
+        if (found >= 0) {
+          Reg r = vals[found].reg;
+          if (r == d) {
+            o.dead[i] = true;
+            continue;
+          }
+          inst->op = MOV;
+          inst->src.type = REG;
+          inst->src.reg = r;
+          n = opt_kill_mem_reg(vals, n, d);
+          continue;
+        }
+        Value addr = inst->src;
+        n = opt_kill_mem_reg(vals, n, d);
+        n = opt_add_mem_val(vals, n, &addr, d);
+      } else if (inst->op == STORE) {
+        int found = opt_find_mem_val(vals, n, &inst->src);
+        if (found >= 0 && vals[found].reg == d) {
+          o.dead[i] = true;
+          continue;
+        }
+        n = opt_kill_mem_alias(vals, n, &inst->src);
+        n = opt_add_mem_val(vals, n, &inst->src, d);
+      } else {
+        int use, def;
+        inst_use_def(inst, &use, &def);
+        if (def)
+          n = opt_kill_mem_reg(vals, n, d);
+      }
+    }
+  }
+  opt_sweep(&o);
+}
+
+static bool opt_is_pure(Op op) {
+  return op == MOV || op == ADD || op == SUB || op == LOAD ||
+      opt_is_cmp(op) || is_ext_op(op);
+}
+
+// Dead register write elimination, using global liveness. Repeats until
+// no more writes die.
+static void opt_eliminate_dead_writes(Module* m) {
+  for (;;) {
+    Opt o;
+    opt_begin(&o, m);
+    Cfg* cfg = build_cfg(m);
+    for (int pc = 0; pc < m->num_blocks; pc++) {
+      BasicBlock* bb = &m->blocks[pc];
+      int live = cfg->blocks[pc].live_out;
+      for (int i = bb->start + bb->len - 1; i >= bb->start; i--) {
+        Inst* inst = &m->insts[i];
+        if (inst->op == EXIT) {
+          live = 0;
+          continue;
+        }
+        int use, def;
+        inst_use_def(inst, &use, &def);
+        if (def && !(def & live) && opt_is_pure(inst->op) &&
+            !inst->magic_comment) {
+          o.dead[i] = true;
+          continue;
+        }
+        live = use | (live & ~def);
+      }
+    }
+    free_cfg(cfg);
+    if (!opt_sweep(&o))
+      break;
+  }
+}
+
+static bool opt_is_jump(Op op) {
+  return op >= JEQ && op <= JMP;
+}
+
+// The pc a block passes control to right away, or -1 if it does some
+// work first. Such blocks are either empty or a lone `jmp`.
+static int opt_trampoline_target(Module* m, int pc) {
+  BasicBlock* bb = &m->blocks[pc];
+  int next = -1;
+  if (bb->len == 0) {
+    next = pc + 1;
+  } else if (bb->len == 1) {
+    Inst* inst = &m->insts[bb->start];
+    if (inst->op == JMP && inst->jmp.type == IMM)
+      next = inst->jmp.imm;
+  }
+  return next >= 0 && next < m->num_blocks ? next : -1;
+}
+
+// Resolves |pc| through trampolines, memoizing the result in |final|.
+// Entries are -1 while unknown and -2 while being resolved, which stops
+// at the first pc of a cycle of trampolines.
+static int opt_thread_target(Module* m, int* final, int pc) {
+  int cur = pc;
+  while (final[cur] == -1) {
+    final[cur] = -2;
+    int next = opt_trampoline_target(m, cur);
+    if (next < 0 || final[next] == -2) {
+      final[cur] = cur;
+      break;
+    }
+    cur = next;
+  }
+  int target = final[cur];
+  for (cur = pc; final[cur] == -2; cur = opt_trampoline_target(m, cur))
+    final[cur] = target;
+  return target;
+}
+
+// Jump threading. Jumps to a block which only jumps on (or is empty)
+// go to the final destination directly, and jumps to the next pc are
+// dropped. Modules with numeric code addresses are left alone.
+static void opt_thread_jumps(Module* m) {
+  if (has_numeric_code_addrs(m))
+    return;
+  Opt o;
+  opt_begin(&o, m);
+  int* final = malloc(sizeof(int) * (m->num_blocks + 1));
+  for (int pc = 0; pc < m->num_blocks; pc++)
+    final[pc] = -1;
+  for (int pc = 0; pc < m->num_blocks; pc++) {
+    BasicBlock* bb = &m->blocks[pc];
+    for (int i = bb->start; i < bb->start + bb->len; i++) {
+      Inst* inst = &m->insts[i];
+      if (!opt_is_jump(inst->op) || inst->jmp.type != IMM)
+        continue;
+      int target = inst->jmp.imm;
+      if (target < 0 || target >= m->num_blocks)
+        continue;
+      target = opt_thread_target(m, final, target);
+      inst->jmp.imm = target;
+      if (target == pc + 1 && i == bb->start + bb->len - 1)
+        o.dead[i] = true;
+    }
+  }
+  free(final);
+  opt_sweep(&o);
+}
+
+// Whether block |pc| can be appended to the block before it. Backends
+// expect a jump to end its block, and split modules also end blocks
+// after memory accesses.
+static bool opt_can_merge(Module* m, Cfg* cfg, int* new_pc, int pc) {
+  CfgBlock* b = &cfg->blocks[pc];
+  if (b->address_taken || b->num_preds != 1 || b->preds[0] != pc - 1 ||
+      new_pc[pc - 1] < 0)
+    return false;
+  BasicBlock* prev = &m->blocks[pc - 1];
+  if (!prev->len)
+    return true;
+  Op op = m->insts[prev->start + prev->len - 1].op;
+  if (opt_is_jump(op) || op == EXIT)
+    return false;
+  if (is_basic_block_split_by_mem() && (op == LOAD || op == STORE))
+    return false;
+  return true;
+}
+
+static void opt_remap_pc(Value* v, int* new_pc, int num_blocks, int n) {
+  if (v->type != IMM || v->label != TEXT_LABEL || v->imm < 0)
+    return;
+  if (v->imm >= num_blocks)
+    v->imm += n - num_blocks;
+  else if (new_pc[v->imm] >= 0)
+    v->imm = new_pc[v->imm];
+}
+
+// Moves block |pc| to |new_pc[pc]|, which is -1 for dropped blocks and
+// the pc of the previous block for merged ones, and remaps text labels
+// in code, data and symbols. |n| is the new number of pcs.
+static void opt_renumber(Module* m, int* new_pc, int n) {
+  Inst root = {};
+  Inst* last = &root;
+  for (int pc = 0; pc < m->num_blocks; pc++) {
+    if (new_pc[pc] < 0)
+      continue;
+    BasicBlock* bb = &m->blocks[pc];
+    for (int i = bb->start; i < bb->start + bb->len; i++) {
+      Inst* inst = &m->insts[i];
+      inst->pc = new_pc[pc];
+      opt_remap_pc(&inst->dst, new_pc, m->num_blocks, n);
+      opt_remap_pc(&inst->src, new_pc, m->num_blocks, n);
+      opt_remap_pc(&inst->jmp, new_pc, m->num_blocks, n);
+      last->next = inst;
+      last = inst;
+    }
+  }
+  last->next = NULL;
+  m->text = root.next;
+
+  for (Data* d = m->data; d; d = d->next) {
+    if (d->label != TEXT_LABEL || d->v < 0)
+      continue;
+    if (d->v >= m->num_blocks)
+      d->v += n - m->num_blocks;
+    else if (new_pc[d->v] >= 0)
+      d->v = new_pc[d->v];
+  }
+
+  // Labels of dropped or merged blocks go away with them.
+  Sym sym_root = {};
+  Sym* prev = &sym_root;
+  for (Sym* sym = m->syms; sym; sym = sym->next) {
+    int pc = sym->value;
+    if (sym->is_text && pc >= 0 && pc < m->num_blocks) {
+      if (new_pc[pc] < 0 || (pc && new_pc[pc] == new_pc[pc - 1]))
+        continue;
+      sym->value = new_pc[pc];
+    } else if (sym->is_text && pc >= m->num_blocks) {
+      sym->value += n - m->num_blocks;
+    }
+    prev->next = sym;
+    prev = sym;
+  }
+  prev->next = NULL;
+  m->syms = sym_root.next;
+  index_module(m);
+}
+
+// Block merging. Blocks which only their predecessor falls into are
+// appended to it, blocks without predecessors are dropped, and the
+// remaining pcs are renumbered densely. Address-taken pcs are never
+// merged away, so code addresses stored anywhere still find their block.
+// Modules with numeric code addresses are left alone.
+static void opt_merge_blocks(Module* m) {
+  if (has_numeric_code_addrs(m))
+    return;
+  Cfg* cfg = build_cfg(m);
+  int* new_pc = malloc(sizeof(int) * (m->num_blocks + 1));
+  int n = 0;
+  for (int pc = 0; pc < m->num_blocks; pc++) {
+    CfgBlock* b = &cfg->blocks[pc];
+    if (pc && !b->num_preds && !b->address_taken)
+      new_pc[pc] = -1;
+    else if (pc && opt_can_merge(m, cfg, new_pc, pc))
+      new_pc[pc] = new_pc[pc - 1];
+    else
+      new_pc[pc] = n++;
+  }
+  free_cfg(cfg);
+  if (n < m->num_blocks)
+    opt_renumber(m, new_pc, n);
+  free(new_pc);
+}
+
+// Reachability state of opt_strip_unreachable. Data is split into
+// ranges at data labels. |work| holds pcs to visit, and ranges as
+// -1 - index.
+typedef struct {
+  Module* m;
+  Data** words;
+  bool* reached;
+  int* starts;
+  bool* live;
+  int num_ranges;
+  int* work;
+  int num_work;
+} OptReach;
+
+static int opt_cmp_int(const void* a, const void* b) {
+  return *(const int*)a - *(const int*)b;
+}
+
+static int opt_find_range(OptReach* r, int addr) {
+  int lo = 0;
+  int hi = r->num_ranges;
+  while (hi - lo > 1) {
+    int mid = (lo + hi) / 2;
+    if (r->starts[mid] <= addr)
+      lo = mid;
+    else
+      hi = mid;
+  }
+  return lo;
+}
+
+static void opt_reach_pc(OptReach* r, int pc) {
+  if (pc < 0 || pc >= r->m->num_blocks || r->reached[pc])
+    return;
+  r->reached[pc] = true;
+  r->work[r->num_work++] = pc;
+}
+
+static void opt_reach_range(OptReach* r, int i) {
+  if (r->live[i])
+    return;
+  r->live[i] = true;
+  r->work[r->num_work++] = -1 - i;
+}
+
+static void opt_reach_value(OptReach* r, Value* v) {
+  if (v->type != IMM)
+    return;
+  if (v->label == TEXT_LABEL)
+    opt_reach_pc(r, v->imm);
+  else if (v->label == DATA_LABEL && v->imm >= 0)
+    opt_reach_range(r, opt_find_range(r, v->imm));
+}
+
+static void opt_visit_block(OptReach* r, int pc) {
+  Module* m = r->m;
+  BasicBlock* bb = &m->blocks[pc];
+  for (int i = bb->start; i < bb->start + bb->len; i++) {
+    Inst* inst = &m->insts[i];
+    opt_reach_value(r, &inst->dst);
+    opt_reach_value(r, &inst->src);
+    if (inst->op == EXIT)
+      return;
+    if (opt_is_jump(inst->op)) {
+      if (inst->jmp.type == IMM)
+        opt_reach_pc(r, inst->jmp.imm);
+      if (inst->op == JMP)
+        return;
+    }
+  }
+  opt_reach_pc(r, pc + 1);
+}
+
+static void opt_visit_range(OptReach* r, int i) {
+  int end = i + 1 < r->num_ranges ?
+      r->starts[i + 1] : r->m->num_data_words;
+  for (int a = r->starts[i]; a < end; a++) {
+    Data* d = r->words[a];
+    if (d->label == TEXT_LABEL)
+      opt_reach_pc(r, d->v);
+    else if (d->label == DATA_LABEL)
+      opt_reach_range(r, opt_find_range(r, d->v));
+  }
+}
+
+// Splits data into ranges which start at data labels. Unlabeled data
+// at address 0 and the word _edata points to, which is always last,
+// get ranges of their own and are always kept.
+static void opt_init_ranges(OptReach* r) {
+  Module* m = r->m;
+  int n = 0;
+  for (Sym* sym = m->syms; sym; sym = sym->next)
+    n++;
+  r->starts = malloc(sizeof(int) * (n + 2));
+  int num_starts = 0;
+  r->starts[num_starts++] = 0;
+  r->starts[num_starts++] = m->num_data_words - 1;
+  for (Sym* sym = m->syms; sym; sym = sym->next) {
+    if (!sym->is_text && sym->value < m->num_data_words - 1)
+      r->starts[num_starts++] = sym->value;
+  }
+  qsort(r->starts, num_starts, sizeof(int), opt_cmp_int);
+  n = 0;
+  for (int i = 0; i < num_starts; i++) {
+    if (!n || r->starts[n - 1] != r->starts[i])
+      r->starts[n++] = r->starts[i];
+  }
+  r->num_ranges = n;
+  r->live = calloc(n + 1, sizeof(bool));
+
+  bool labeled_zero = false;
+  for (Sym* sym = m->syms; sym; sym = sym->next) {
+    if (!sym->is_text && sym->value == 0)
+      labeled_zero = true;
+  }
+  if (!labeled_zero)
+    opt_reach_range(r, 0);
+  opt_reach_range(r, n - 1);
+}
+
+static int opt_new_addr(int* new_addr, int num_words, int a) {
+  if (a < 0)
+    return a;
+  if (a >= num_words)
+    return a - num_words + new_addr[num_words];
+  return new_addr[a];
+}
+
+static void opt_remap_addr(Value* v, int* new_addr, int num_words) {
+  if (v->type == IMM && v->label == DATA_LABEL)
+    v->imm = opt_new_addr(new_addr, num_words, v->imm);
+}
+
+// Drops data ranges nothing reachable refers to and moves the rest
+// down. The word _edata points to holds the first address after data,
+// so it is rewritten to match.
+static void opt_strip_data(OptReach* r) {
+  Module* m = r->m;
+  int num_words = m->num_data_words;
+  int* new_addr = malloc(sizeof(int) * (num_words + 1));
+  int n = 0;
+  for (int i = 0; i < r->num_ranges; i++) {
+    int end = i + 1 < r->num_ranges ? r->starts[i + 1] : num_words;
+    for (int a = r->starts[i]; a < end; a++) {
+      new_addr[a] = n;
+      if (r->live[i])
+        n++;
+    }
+  }
+  new_addr[num_words] = n;
+  if (n == num_words) {
+    free(new_addr);
+    return;
+  }
+
+  Data root = {};
+  Data* last = &root;
+  for (int i = 0; i < r->num_ranges; i++) {
+    if (!r->live[i])
+      continue;
+    int end = i + 1 < r->num_ranges ? r->starts[i + 1] : num_words;
+    for (int a = r->starts[i]; a < end; a++) {
+      Data* d = r->words[a];
+      if (d->label == DATA_LABEL)
+        d->v = opt_new_addr(new_addr, num_words, d->v);
+      last->next = d;
+      last = d;
+    }
+  }
+  last->next = NULL;
+  last->v = n;
+  m->data = root.next;
+
+  for (int i = 0; i < m->num_insts; i++) {
+    Inst* inst = &m->insts[i];
+    opt_remap_addr(&inst->dst, new_addr, num_words);
+    opt_remap_addr(&inst->src, new_addr, num_words);
+  }
+
+  Sym sym_root = {};
+  Sym* prev = &sym_root;
+  for (Sym* sym = m->syms; sym; sym = sym->next) {
+    if (!sym->is_text) {
+      if (sym->value < num_words &&
+          !r->live[opt_find_range(r, sym->value)])
+        continue;
+      sym->value = opt_new_addr(new_addr, num_words, sym->value);
+    }
+    prev->next = sym;
+    prev = sym;
+  }
+  prev->next = NULL;
+  m->syms = sym_root.next;
+
+  free(new_addr);
+  index_module(m);
+}
+
+// Whole-program dead code and data stripping. Code is reachable from
+// pc 0 through direct jumps, fallthrough, and text labels used by
+// reachable code or kept data; register jumps can only go to the
+// latter. Data ranges are kept when reachable code or kept data refers
+// to one of their labels. Modules with numeric code addresses are left
+// alone, since renumbering would break them.
+static void opt_strip_unreachable(Module* m) {
+  if (has_numeric_code_addrs(m) || !m->num_data_words ||
+      m->data_words[m->num_data_words - 1] != m->num_data_words)
+    return;
+
+  OptReach r = {};
+  r.m = m;
+  r.words = malloc(sizeof(Data*) * m->num_data_words);
+  int i = 0;
+  for (Data* d = m->data; d; d = d->next)
+    r.words[i++] = d;
+  r.reached = calloc(m->num_blocks + 1, sizeof(bool));
+  r.work = malloc(sizeof(int) * (m->num_blocks + m->num_data_words + 2));
+  opt_init_ranges(&r);
+  if (has_numeric_data_addrs(m)) {
+    for (i = 0; i < r.num_ranges; i++)
+      opt_reach_range(&r, i);
+  }
+  opt_reach_pc(&r, 0);
+  while (r.num_work) {
+    int w = r.work[--r.num_work];
+    if (w >= 0)
+      opt_visit_block(&r, w);
+    else
+      opt_visit_range(&r, -1 - w);
+  }
+
+  int* new_pc = malloc(sizeof(int) * (m->num_blocks + 1));
+  int n = 0;
+  for (int pc = 0; pc < m->num_blocks; pc++)
+    new_pc[pc] = r.reached[pc] ? n++ : -1;
+  if (n < m->num_blocks)
+    opt_renumber(m, new_pc, n);
+  free(new_pc);
+
+  opt_strip_data(&r);
+  free(r.words);
+  free(r.reached);
+  free(r.starts);
+  free(r.live);
+  free(r.work);
+}
+
+typedef struct {
+  const char* name;
+  void (*run)(Module* m);
+} OptPass;
+
+static const OptPass OPT_PASSES_O1[] = {
+  { "strip", opt_strip_unreachable },
+  { "thread", opt_thread_jumps },
+  { "merge", opt_merge_blocks },
+  { "fold", opt_fold_consts },
+  { "copy", opt_propagate_copies },
+  { "mem", opt_eliminate_mem },
+  { "fold", opt_fold_consts },
+  { "dce", opt_eliminate_dead_writes },
+  { "thread", opt_thread_jumps },
+  { "merge", opt_merge_blocks },
+  { NULL, NULL },
+};
+
+void optimize_module(Module* m, int level, bool verbose) {
+  if (level <= 0)
+    return;
+  if (verbose) {
+    fprintf(stderr, "opt: input: %d insts, %d pcs\n",
+            m->num_insts, m->num_blocks);
+  }
+  for (const OptPass* pass = OPT_PASSES_O1; pass->name; pass++) {
+    int before = m->num_insts;
+    pass->run(m);
+    if (verbose) {
+      fprintf(stderr, "opt: %s: %d insts (-%d), %d pcs\n",
+              pass->name, m->num_insts, before - m->num_insts,
+              m->num_blocks);
+    }
+  }
+}
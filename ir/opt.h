@@ -0,0 +1,13 @@
+#ifndef ELVM_OPT_H_
+#define ELVM_OPT_H_
+
+#include <stdbool.h>
+
+#include <ir/ir.h>
+
+// Runs the optimization passes enabled at |level| on an indexed module.
+// Level 0 does nothing. With |verbose|, the number of instructions left
+// after each pass is reported to stderr.
+void optimize_module(Module* m, int level, bool verbose);
+
+#endif  // ELVM_OPT_H_
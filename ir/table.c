@@ -3,20 +3,78 @@
 #include <stdlib.h>
 #include <string.h>
 
+#define TABLE_INITIAL_CAP 64
+
+// djb2, written with additions only as multiplication is a software
+// loop when this file is compiled to EIR.
+static unsigned int table_hash(const char* key) {
+  unsigned int h = 5381;
+  for (; *key; key++) {
+    unsigned int h32 = h + h;
+    h32 += h32;
+    h32 += h32;
+    h32 += h32;
+    h32 += h32;
+    h = h32 + h + (unsigned char)*key;
+  }
+  return h;
+}
+
+static TableEntry* table_find(Table* tbl, const char* key, unsigned int h) {
+  int mask = tbl->cap - 1;
+  int i = h & mask;
+  for (;;) {
+    TableEntry* e = &tbl->entries[i];
+    if (!e->key)
+      return e;
+    if (e->hash == h && (e->key == key || !strcmp(e->key, key)))
+      return e;
+    if (++i == tbl->cap)
+      i = 0;
+  }
+}
+
+static void table_grow(Table* tbl) {
+  TableEntry* old = tbl->entries;
+  int old_cap = tbl->cap;
+  tbl->cap = old_cap ? old_cap * 2 : TABLE_INITIAL_CAP;
+  tbl->entries = calloc(tbl->cap, sizeof(TableEntry));
+  for (int i = 0; i < old_cap; i++) {
+    if (old[i].key)
+      *table_find(tbl, old[i].key, old[i].hash) = old[i];
+  }
+  free(old);
+}
+
 Table* table_add(Table* tbl, const char* key, const void* value) {
-  Table* ntbl = malloc(sizeof(Table));
-  ntbl->next = tbl;
-  ntbl->key = key;
-  ntbl->value = value;
-  return ntbl;
+  if (!tbl)
+    tbl = calloc(1, sizeof(Table));
+  if ((tbl->size + 1) * 4 > tbl->cap * 3)
+    table_grow(tbl);
+  unsigned int h = table_hash(key);
+  TableEntry* e = table_find(tbl, key, h);
+  if (!e->key) {
+    e->key = key;
+    e->hash = h;
+    tbl->size++;
+  }
+  e->value = value;
+  return tbl;
 }
 
 bool table_get(Table* tbl, const char* key, const void** value) {
-  for (; tbl; tbl = tbl->next) {
-    if (!strcmp(tbl->key, key)) {
-      *value = tbl->value;
-      return true;
-    }
-  }
-  return false;
+  if (!tbl)
+    return false;
+  TableEntry* e = table_find(tbl, key, table_hash(key));
+  if (!e->key)
+    return false;
+  *value = e->value;
+  return true;
+}
+
+void table_free(Table* tbl) {
+  if (!tbl)
+    return;
+  free(tbl->entries);
+  free(tbl);
 }
@@ -3,14 +3,25 @@
 
 #include <stdbool.h>
 
-typedef struct Table_ {
+typedef struct {
   const char* key;
   const void* value;
-  struct Table_* next;
+  unsigned int hash;
+} TableEntry;
+
+// An open-addressing hash table keyed by strings. Keys are not copied,
+// so they must outlive the table. A NULL Table* is a valid empty table.
+typedef struct Table_ {
+  TableEntry* entries;
+  int cap;
+  int size;
 } Table;
 
 Table* table_add(Table* tbl, const char* key, const void* value);
 
 bool table_get(Table* tbl, const char* key, const void** value);
 
+// Frees the table itself. Keys and values are owned by the caller.
+void table_free(Table* tbl);
+
 #endif  // ELVM_TABLE_H_
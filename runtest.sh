@@ -18,6 +18,17 @@ if [ -z "${ins}" ]; then
     else
         ${cmd} < /dev/null > ${tmp}
     fi
+elif [ "$(basename $1)" = eli ] && [ $# = 2 ]; then
+    # Runs all inputs at once on eli's thread pool.
+    rm -rf ${tmp} ${tmp}.d
+    echo "${ins}" > ${tmp}.list
+    $1 -batch $2 ${tmp}.list ${tmp}.d
+    for i in ${ins}; do
+        echo "=== ${i} ===" >> ${tmp}
+        cat ${tmp}.d/$(basename ${i}).out >> ${tmp}
+        echo >> ${tmp}
+    done
+    rm -rf ${tmp}.list ${tmp}.d
 else
     rm -f ${tmp}
     for i in ${ins}; do
@@ -93,6 +93,49 @@ static void c_emit_inst(Inst* inst) {
               reg_names[inst->dst.reg], cmp_str(inst, "1"));
     break;
 
+  case MUL:
+    emit_line("%s = (%s * %s) & " UINT_MAX_STR ";",
+              reg_names[inst->dst.reg],
+              reg_names[inst->dst.reg], src_str(inst));
+    break;
+
+  case DIV:
+    emit_line("%s = %s ? %s / %s : " UINT_MAX_STR ";",
+              reg_names[inst->dst.reg], src_str(inst),
+              reg_names[inst->dst.reg], src_str(inst));
+    break;
+
+  case MOD:
+    emit_line("%s = %s ? %s %% %s : %s;",
+              reg_names[inst->dst.reg], src_str(inst),
+              reg_names[inst->dst.reg], src_str(inst),
+              reg_names[inst->dst.reg]);
+    break;
+
+  case AND:
+    emit_line("%s &= %s;", reg_names[inst->dst.reg], src_str(inst));
+    break;
+
+  case OR:
+    emit_line("%s |= %s;", reg_names[inst->dst.reg], src_str(inst));
+    break;
+
+  case XOR:
+    emit_line("%s ^= %s;", reg_names[inst->dst.reg], src_str(inst));
+    break;
+
+  case SHL:
+    emit_line("%s = %s < 24 ? (%s << %s) & " UINT_MAX_STR " : 0;",
+              reg_names[inst->dst.reg], src_str(inst),
+              reg_names[inst->dst.reg], src_str(inst));
+    break;
+
+  case SHR:
+    emit_line("%s = %s < 24 ? %s >> %s : 0;",
+              reg_names[inst->dst.reg], src_str(inst),
+              reg_names[inst->dst.reg], src_str(inst));
+    break;
+
   case JEQ:
   case JNE:
   case JLT:
@@ -112,11 +155,11 @@ static void c_emit_inst(Inst* inst) {
 void target_c(Module* module) {
   c_init_state();
 
-  int num_funcs = emit_chunked_main_loop(module->text,
-                                         c_emit_func_prologue,
-                                         c_emit_func_epilogue,
-                                         c_emit_pc_change,
-                                         c_emit_inst);
+  int num_funcs = emit_parallel_chunked_main_loop(module->text,
+                                                  c_emit_func_prologue,
+                                                  c_emit_func_epilogue,
+                                                  c_emit_pc_change,
+                                                  c_emit_inst);
 
   emit_line("int main() {");
   inc_indent();
@@ -464,6 +464,17 @@ static char const* cmake_op_str(Op op) {
   case LE: return "LE";
   case GE: return "GE";
   case DUMP: return "DUMP";
+
+  // Lowered by elc before this target runs.
+  case MUL:
+  case DIV:
+  case MOD:
+  case AND:
+  case OR:
+  case XOR:
+  case SHL:
+  case SHR:
+    break;
   }
 
   error(format("Unsupported opcode %d", op));
@@ -141,7 +141,7 @@ void target_cs(Module* module) {
 
   int num_inits = cs_init_state(module->data);
 
-  CHUNKED_FUNC_SIZE = 256;
+  set_default_chunked_func_size(256);
   int num_funcs = emit_chunked_main_loop(module->text,
                                          cs_emit_func_prologue,
                                          cs_emit_func_epilogue,
@@ -0,0 +1,140 @@
+#include <ir/eirb.h>
+#include <ir/ir.h>
+#include <target/util.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+static int eirb_types(Inst* inst) {
+  int types = 0;
+  if (inst->dst.type == IMM)
+    types += 1;
+  if (inst->src.type == IMM)
+    types += 2;
+  if (inst->jmp.type == IMM)
+    types += 4;
+  types += inst->dst.label * 8;
+  types += inst->src.label * 32;
+  types += inst->jmp.label * 128;
+  return types;
+}
+
+static void eirb_emit_value(Value* v) {
+  emit_le(v->type == REG ? (int)v->reg : v->imm);
+}
+
+static void eirb_emit_string(const char* s) {
+  int len = strlen(s);
+  emit_le(len);
+  for (int i = 0; i < len; i++)
+    emit_1(s[i]);
+  for (int i = len; i % 4 != 3; i++)
+    emit_1(0);
+  emit_1(0);
+}
+
+// Source locations, numbered in text order. Instructions which share a
+// SrcLoc in a row share an entry, and file names are emitted once.
+typedef struct {
+  SrcLoc** locs;
+  int num_locs;
+  const char** files;
+  int num_files;
+} EirbLocs;
+
+static int eirb_file_index(EirbLocs* l, const char* file) {
+  if (!file)
+    return 0;
+  for (int i = 0; i < l->num_files; i++) {
+    if (!strcmp(l->files[i], file))
+      return i + 1;
+  }
+  l->files[l->num_files++] = file;
+  return l->num_files;
+}
+
+static void eirb_collect_locs(EirbLocs* l, Module* module, int num_insts) {
+  l->locs = malloc(sizeof(SrcLoc*) * (num_insts + 1));
+  l->files = malloc(sizeof(char*) * (num_insts + 1));
+  l->num_locs = 0;
+  l->num_files = 0;
+  SrcLoc* prev = NULL;
+  for (Inst* inst = module->text; inst; inst = inst->next) {
+    if (inst->loc && inst->loc != prev) {
+      l->locs[l->num_locs++] = inst->loc;
+      eirb_file_index(l, inst->loc->file);
+    }
+    prev = inst->loc;
+  }
+}
+
+void target_eirb(Module* module) {
+  int num_insts = 0;
+  int num_magics = 0;
+  for (Inst* inst = module->text; inst; inst = inst->next) {
+    num_insts++;
+    if (inst->magic_comment)
+      num_magics++;
+  }
+  int num_data = 0;
+  for (Data* data = module->data; data; data = data->next)
+    num_data++;
+  int num_syms = 0;
+  for (Sym* sym = module->syms; sym; sym = sym->next)
+    num_syms++;
+  EirbLocs locs;
+  eirb_collect_locs(&locs, module, num_insts);
+
+  emit_4(EIRB_MAGIC[0], EIRB_MAGIC[1], EIRB_MAGIC[2], EIRB_MAGIC[3]);
+  emit_le(EIRB_VERSION);
+  emit_le(num_insts);
+  emit_le(num_data);
+  emit_le(num_syms);
+  emit_le(locs.num_files);
+  emit_le(locs.num_locs);
+  emit_le(num_magics);
+
+  for (int i = 0; i < locs.num_files; i++)
+    eirb_emit_string(locs.files[i]);
+  for (int i = 0; i < locs.num_locs; i++) {
+    emit_le(locs.locs[i]->line);
+    emit_le(eirb_file_index(&locs, locs.locs[i]->file));
+  }
+
+  int loc = 0;
+  SrcLoc* prev = NULL;
+  for (Inst* inst = module->text; inst; inst = inst->next) {
+    if (inst->loc && inst->loc != prev)
+      loc++;
+    prev = inst->loc;
+    emit_le(inst->op);
+    emit_le(eirb_types(inst));
+    eirb_emit_value(&inst->dst);
+    eirb_emit_value(&inst->src);
+    eirb_emit_value(&inst->jmp);
+    emit_le(inst->pc);
+    emit_le(inst->lineno + 1);
+    emit_le(inst->loc ? loc : 0);
+  }
+
+  for (Data* data = module->data; data; data = data->next) {
+    emit_le(data->v);
+    emit_le(data->label);
+  }
+
+  for (Sym* sym = module->syms; sym; sym = sym->next) {
+    emit_le(sym->value);
+    emit_le(sym->is_text);
+    eirb_emit_string(sym->name);
+  }
+
+  int i = 0;
+  for (Inst* inst = module->text; inst; inst = inst->next, i++) {
+    if (inst->magic_comment) {
+      emit_le(i);
+      eirb_emit_string(inst->magic_comment);
+    }
+  }
+  free(locs.locs);
+  free(locs.files);
+}
@@ -1,8 +1,18 @@
+#include <ctype.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#ifndef __eir__
+#include <errno.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+#endif
 
 #include <ir/ir.h>
+#include <ir/lower.h>
+#include <ir/opt.h>
 #include <target/util.h>
 
 void target_arm(Module* module);
@@ -18,6 +28,7 @@ void target_cpp(Module* module);
 void target_cpp_template(Module* module);
 void target_cr(Module* module);
 void target_cs(Module* module);
+void target_eirb(Module* module);
 void target_el(Module* module);
 void target_f90(Module* module);
 void target_forth(Module* module);
@@ -88,6 +99,7 @@ static target_func_t get_target_func(const char* ext) {
   if (!strcmp(ext, "cpp_template")) return target_cpp_template;
   if (!strcmp(ext, "cr")) return target_cr;
   if (!strcmp(ext, "cs")) return target_cs;
+  if (!strcmp(ext, "eirb")) return target_eirb;
   if (!strcmp(ext, "el")) return target_el;
   if (!strcmp(ext, "f90")) return target_f90;
   if (!strcmp(ext, "forth")) return target_forth;
@@ -144,16 +156,130 @@ static target_func_t get_target_func(const char* ext) {
   error("unknown flag: %s", ext);
 }
 
+// Targets which emit the extended arithmetic operations (MUL ... SHR)
+// natively. Modules are lowered for all the others.
+static bool has_ext_ops(const char* ext) {
+  return !strcmp(ext, "c") || !strcmp(ext, "eirb") ||
+      !strcmp(ext, "js") || !strcmp(ext, "x86");
+}
+
 bool handle_mcfunction_args(const char* arg, const char* value);
 
 typedef bool (*handle_args_func_t)(const char*, const char*);
 
+// Targets which emit their text with emit_chunked_main_loop, and so
+// take -chunked_func_size.
+static bool uses_chunked_main_loop(const char* ext) {
+  static const char* EXTS[] = {
+    "asmjs", "awk", "c", "cl", "cmake", "cr", "cs", "el", "f90", "forth",
+    "fs", "hs", "j", "java", "js", "kx", "ll", "lol", "lua", "oct", "php",
+    "ps", "py", "qftasm", "rb", "rs", "scala", "swift", "tcl", "vim",
+    "wasi", "wasm", NULL
+  };
+  for (int i = 0; EXTS[i]; i++) {
+    if (!strcmp(ext, EXTS[i]))
+      return true;
+  }
+  return false;
+}
+
 static handle_args_func_t get_handle_args_func(const char* ext) {
   if (!strcmp(ext, "mcfunction")) return handle_mcfunction_args;
-  if (!strcmp(ext, "rb")) return handle_chunked_func_size_arg;
+  if (uses_chunked_main_loop(ext)) return handle_chunked_func_size_arg;
   return NULL;
 }
 
+#ifndef __eir__
+static void report_emit_speed(const char* ext, const struct timespec* start) {
+  struct timespec end;
+  fflush(stdout);
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  double secs = (end.tv_sec - start->tv_sec) +
+      (end.tv_nsec - start->tv_nsec) / 1e9;
+  long bytes = ftell(stdout);
+  if (bytes < 0) {
+    fprintf(stderr, "emit: %s: %.3fs (output is not seekable)\n", ext, secs);
+    return;
+  }
+  fprintf(stderr, "emit: %s: %ld bytes in %.3fs (%.1f MB/s)\n",
+          ext, bytes, secs, secs > 0 ? bytes / secs / 1e6 : 0.0);
+}
+
+static void emit_target(Module* module, const char* ext,
+                        target_func_t target_func, const char* output,
+                        bool verbose) {
+  if (!has_ext_ops(ext))
+    lower_ext_ops(module);
+  emit_init_output(output);
+  struct timespec start;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  target_func(module);
+  if (verbose)
+    report_emit_speed(ext, &start);
+}
+
+// Emits <outdir>/<basename of filename>.<ext> for each of the comma
+// separated |targets|. The module is loaded once, and each target runs
+// in a forked process with its own copy of it, as backends keep their
+// state in globals. At most one process per CPU (or -jobs=N) runs at a
+// time, so each target emits its chunks in a single process.
+static int emit_targets(const char* filename, const char* targets,
+                        const char* outdir, int opt_level, bool verbose) {
+  if (mkdir(outdir, 0777) && errno != EEXIST)
+    error("cannot create %s", outdir);
+  Module* module = load_eir_from_file(filename);
+  optimize_module(module, opt_level, verbose);
+  const char* base = strrchr(filename, '/');
+  base = base ? base + 1 : filename;
+
+  int jobs = EMIT_JOBS > 0 ? EMIT_JOBS : sysconf(_SC_NPROCESSORS_ONLN);
+  int running = 0;
+  int status = 0;
+  fflush(NULL);
+  for (const char* p = targets; *p;) {
+    const char* end = strchr(p, ',');
+    if (!end)
+      end = p + strlen(p);
+    char* ext = format("%.*s", (int)(end - p), p);
+    p = *end ? end + 1 : end;
+    if (!*ext)
+      continue;
+
+    if (running == jobs) {
+      int st;
+      wait(&st);
+      running--;
+      if (!WIFEXITED(st) || WEXITSTATUS(st))
+        status = 1;
+    }
+    pid_t pid = fork();
+    if (pid < 0)
+      error("fork failed");
+    if (pid == 0) {
+      EMIT_JOBS = 1;
+      target_func_t target_func = get_target_func(ext);
+      // The bf and wm targets need blocks split at memory accesses.
+      if (is_basic_block_split_by_mem()) {
+        module = load_eir_from_file(filename);
+        optimize_module(module, opt_level, false);
+      }
+      emit_target(module, ext, target_func,
+                  format("%s/%s.%s", outdir, base, ext), verbose);
+      exit(0);
+    }
+    running++;
+  }
+  for (; running; running--) {
+    int st;
+    wait(&st);
+    if (!WIFEXITED(st) || WEXITSTATUS(st))
+      status = 1;
+  }
+  free_module(module);
+  return status;
+}
+#endif
+
 int main(int argc, char* argv[]) {
 #if defined(NOFILE) || defined(__eir__)
   char buf[32];
@@ -167,16 +293,39 @@ int main(int argc, char* argv[]) {
   }
   target_func_t target_func = get_target_func(buf);
   Module* module = load_eir(stdin);
+  if (!has_ext_ops(buf))
+    lower_ext_ops(module);
+  emit_init_output(NULL);
+  target_func(module);
+  free_module(module);
 #else
   target_func_t target_func = NULL;
   const char* ext = NULL;
   const char* filename = NULL;
+  const char* targets = NULL;
+  const char* outdir = ".";
+  const char* output = NULL;
+  int opt_level = 0;
+  bool verbose = false;
   for (int i = 1; i < argc; i++) {
     const char* arg = argv[i];
-    if (arg[0] == '-') {
+    if (arg[0] == '-' && arg[1] == 'O' && isdigit(arg[2]) && !arg[3]) {
+      opt_level = arg[2] - '0';
+    } else if (!strcmp(arg, "-v")) {
+      verbose = true;
+    } else if (!strcmp(arg, "-o") && i + 1 < argc) {
+      output = argv[++i];
+    } else if (!strncmp(arg, "-targets=", 9)) {
+      targets = arg + 9;
+    } else if (!strncmp(arg, "-jobs=", 6)) {
+      EMIT_JOBS = atoi(arg + 6);
+    } else if (!strcmp(arg, "-outdir") && i + 1 < argc) {
+      outdir = argv[++i];
+    } else if (arg[0] == '-') {
       if (target_func) {
         handle_args_func_t handle_args = get_handle_args_func(ext);
-        if (!handle_args || !handle_args(arg + 1, argv[++i])) {
+        if (!handle_args || i + 1 >= argc ||
+            !handle_args(arg + 1, argv[++i])) {
           error("unknown flag");
         }
       } else {
@@ -191,11 +340,18 @@ int main(int argc, char* argv[]) {
   if (!filename) {
     error("no input file");
   }
+  if (targets) {
+    if (target_func || output)
+      error("-targets cannot be used with a target flag or -o");
+    return emit_targets(filename, targets, outdir, opt_level, verbose);
+  }
   if (!target_func) {
     error("no target");
   }
 
   Module* module = load_eir_from_file(filename);
+  optimize_module(module, opt_level, verbose);
+  emit_target(module, ext, target_func, output, verbose);
+  free_module(module);
 #endif
-  target_func(module);
 }
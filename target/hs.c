@@ -227,7 +227,7 @@ void target_hs(Module* module) {
 
   int num_inits = hs_init_state(module->data);
 
-  CHUNKED_FUNC_SIZE = 128;
+  set_default_chunked_func_size(128);
   int num_funcs = emit_chunked_main_loop(module->text,
                                          hs_emit_func_prologue,
                                          hs_emit_func_epilogue,
@@ -137,12 +137,12 @@ void target_java(Module* module) {
 
   int num_inits = java_init_state(module->data);
 
-  CHUNKED_FUNC_SIZE = 256;
-  int num_funcs = emit_chunked_main_loop(module->text,
-                                         java_emit_func_prologue,
-                                         java_emit_func_epilogue,
-                                         java_emit_pc_change,
-                                         java_emit_inst);
+  set_default_chunked_func_size(256);
+  int num_funcs = emit_parallel_chunked_main_loop(module->text,
+                                                  java_emit_func_prologue,
+                                                  java_emit_func_epilogue,
+                                                  java_emit_pc_change,
+                                                  java_emit_inst);
 
   emit_line("public static void main(String[] args) {");
   inc_indent();
@@ -97,6 +97,49 @@ static void js_emit_inst(Inst* inst) {
               reg_names[inst->dst.reg], cmp_str(inst, "true"));
     break;
 
+  case MUL:
+    emit_line("%s = Math.imul(%s, %s) & " UINT_MAX_STR ";",
+              reg_names[inst->dst.reg],
+              reg_names[inst->dst.reg], src_str(inst));
+    break;
+
+  case DIV:
+    emit_line("%s = %s ? Math.floor(%s / %s) : " UINT_MAX_STR ";",
+              reg_names[inst->dst.reg], src_str(inst),
+              reg_names[inst->dst.reg], src_str(inst));
+    break;
+
+  case MOD:
+    emit_line("%s = %s ? %s %% %s : %s;",
+              reg_names[inst->dst.reg], src_str(inst),
+              reg_names[inst->dst.reg], src_str(inst),
+              reg_names[inst->dst.reg]);
+    break;
+
+  case AND:
+    emit_line("%s &= %s;", reg_names[inst->dst.reg], src_str(inst));
+    break;
+
+  case OR:
+    emit_line("%s |= %s;", reg_names[inst->dst.reg], src_str(inst));
+    break;
+
+  case XOR:
+    emit_line("%s ^= %s;", reg_names[inst->dst.reg], src_str(inst));
+    break;
+
+  case SHL:
+    emit_line("%s = %s < 24 ? (%s << %s) & " UINT_MAX_STR " : 0;",
+              reg_names[inst->dst.reg], src_str(inst),
+              reg_names[inst->dst.reg], src_str(inst));
+    break;
+
+  case SHR:
+    emit_line("%s = %s < 24 ? %s >> %s : 0;",
+              reg_names[inst->dst.reg], src_str(inst),
+              reg_names[inst->dst.reg], src_str(inst));
+    break;
+
   case JEQ:
   case JNE:
   case JLT:
@@ -118,11 +161,11 @@ void target_js(Module* module) {
 
   emit_line("var running = true;");
 
-  int num_funcs = emit_chunked_main_loop(module->text,
-                                         js_emit_func_prologue,
-                                         js_emit_func_epilogue,
-                                         js_emit_pc_change,
-                                         js_emit_inst);
+  int num_funcs = emit_parallel_chunked_main_loop(module->text,
+                                                  js_emit_func_prologue,
+                                                  js_emit_func_epilogue,
+                                                  js_emit_pc_change,
+                                                  js_emit_inst);
 
   emit_line("");
   emit_line("while (running) {");
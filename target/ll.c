@@ -132,11 +132,11 @@ const char* ll_emit_load(Inst* inst) {
     emit_line("%%%d = load i32, i32* @%s, align 4", func_idx, reg_names[inst->dst.reg]);
     emit_line("%%%d = load i32, i32* @%s, align 4", func_idx+1, src_str(inst));
     func_idx += 2;
-    return format("%d", func_idx);
+    return scratch_format("%d", func_idx);
   } else if (inst->src.type == IMM) {
     emit_line("%%%d = load i32, i32* @%s, align 4", func_idx, reg_names[inst->dst.reg]);
     func_idx += 1;
-    return format("@%s", reg_names[inst->dst.reg]);
+    return scratch_format("@%s", reg_names[inst->dst.reg]);
   } else {
     error("invalid value");
   }
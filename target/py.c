@@ -117,11 +117,11 @@ static void py_emit_inst(Inst* inst) {
 void target_py(Module* module) {
   init_state_py(module->data);
 
-  int num_funcs = emit_chunked_main_loop(module->text,
-                                         py_emit_func_prologue,
-                                         py_emit_func_epilogue,
-                                         py_emit_pc_change,
-                                         py_emit_inst);
+  int num_funcs = emit_parallel_chunked_main_loop(module->text,
+                                                  py_emit_func_prologue,
+                                                  py_emit_func_epilogue,
+                                                  py_emit_pc_change,
+                                                  py_emit_inst);
 
   emit_line("");
   emit_line("while True:");
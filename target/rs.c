@@ -197,11 +197,11 @@ static void rs_emit_inst(Inst* inst) {
 void target_rs(Module* module) {
   rs_init_state();
 
-  int num_funcs = emit_chunked_main_loop(module->text,
-                                         rs_emit_func_prologue,
-                                         rs_emit_func_epilogue,
-                                         rs_emit_pc_change,
-                                         rs_emit_inst);
+  int num_funcs = emit_parallel_chunked_main_loop(module->text,
+                                                  rs_emit_func_prologue,
+                                                  rs_emit_func_epilogue,
+                                                  rs_emit_pc_change,
+                                                  rs_emit_inst);
 
   emit_line("");
   emit_line("#[allow(unreachable_code)]");
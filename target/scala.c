@@ -138,7 +138,7 @@ void target_scala(Module* module) {
 
   int num_inits = scala_init_state(module->data);
 
-  CHUNKED_FUNC_SIZE = 128;
+  set_default_chunked_func_size(128);
   int num_funcs = emit_chunked_main_loop(module->text,
                                          scala_emit_func_prologue,
                                          scala_emit_func_epilogue,
@@ -90,7 +90,7 @@ static void sqlite3_transpose_insts(Inst* inst, SQLite3CaseExpr* cols[]) {
     switch (inst->op) {
     case MOV:
       col_idx = (SQLite3Col)inst->dst.reg;
-      expr = src_str(inst);
+      expr = format("%s", src_str(inst));
       break;
 
     case ADD:
@@ -162,7 +162,7 @@ static void sqlite3_transpose_insts(Inst* inst, SQLite3CaseExpr* cols[]) {
     case JMP:
       cols[SQLITE3_STEP] = sqlite3_add_expr(cols[SQLITE3_STEP], inst->pc, step, "0");
       col_idx = SQLITE3_PC;
-      expr = value_str(&inst->jmp);
+      expr = format("%s", value_str(&inst->jmp));
       break;
 
     default:
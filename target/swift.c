@@ -148,7 +148,7 @@ void target_swift(Module* module) {
 
   int num_inits = swift_init_state(module->data);
 
-  CHUNKED_FUNC_SIZE = 256;
+  set_default_chunked_func_size(256);
   int num_funcs = emit_chunked_main_loop(module->text,
                                          swift_emit_func_prologue,
                                          swift_emit_func_epilogue,
@@ -6,6 +6,10 @@
 #include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
+#ifndef __eir__
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
 
 char* vformat(const char* fmt, va_list ap) {
   char buf[256];
@@ -28,6 +32,30 @@ char* format(const char* fmt, ...) {
   return r;
 }
 
+#define SCRATCH_SLOTS 64
+#define SCRATCH_SLOT_SIZE 128
+
+const char* scratch_format(const char* fmt, ...) {
+  va_list ap;
+  va_start(ap, fmt);
+#ifdef __eir__
+  // The vsnprintf of the ELVM libc overruns truncated buffers.
+  char* r = vformat(fmt, ap);
+#else
+  static char ring[SCRATCH_SLOTS][SCRATCH_SLOT_SIZE];
+  static int next;
+  va_list va_cpy;
+  va_copy(va_cpy, ap);
+  char* r = ring[next];
+  next = (next + 1) % SCRATCH_SLOTS;
+  if (vsnprintf(r, SCRATCH_SLOT_SIZE, fmt, ap) >= SCRATCH_SLOT_SIZE)
+    r = vformat(fmt, va_cpy);
+  va_end(va_cpy);
+#endif
+  va_end(ap);
+  return r;
+}
+
 void error(const char* fmt, ...) {
   va_list ap;
   va_start(ap, fmt);
@@ -49,46 +77,81 @@ void dec_indent() {
   g_indent--;
 }
 
-void emit_line(const char* fmt, ...) {
-  if (fmt[0]) {
-    if (g_emit_started){
-      g_emit_cnt += g_indent;
-      for (int i = 0; i < g_indent; i++)
-        putchar(' ');
-      va_list ap;
-      va_start(ap, fmt);
-      g_emit_cnt += vprintf(fmt, ap);
-      va_end(ap);
-    } else {
-      g_emit_cnt += g_indent;
-      va_list ap;
-      va_start(ap, fmt);
-      g_emit_cnt += vsnprintf(NULL, 0, fmt, ap);
-      va_end(ap);
-    }
+#define EMIT_BUFSZ (1 << 20)
+
+#ifdef __GLIBC__
+#define EMIT_PUTC(c) putchar_unlocked(c)
+#else
+#define EMIT_PUTC(c) putchar(c)
+#endif
+
+void emit_init_output(const char* path) {
+#ifndef __eir__
+  if (path && !freopen(path, "wb", stdout))
+    error("cannot open %s", path);
+  setvbuf(stdout, NULL, _IOFBF, EMIT_BUFSZ);
+#else
+  if (path)
+    error("-o is not supported");
+#endif
+}
+
+// Writes the indentation, the formatted text and an optional newline
+// with a few fwrites, instead of a putchar per space.
+static void emit_vstr(const char* fmt, va_list ap, bool newline) {
+  static const char SPACES[] = "                                ";
+  if (!fmt[0]) {
+    if (g_emit_started && newline)
+      EMIT_PUTC('\n');
+    return;
   }
-  if (g_emit_started)
-    putchar('\n');
+  g_emit_cnt += g_indent;
+  if (!g_emit_started) {
+    g_emit_cnt += vsnprintf(NULL, 0, fmt, ap);
+    return;
+  }
+  for (int i = 0; i < g_indent; i += sizeof(SPACES) - 1) {
+    int n = g_indent - i;
+    if (n > (int)sizeof(SPACES) - 1)
+      n = sizeof(SPACES) - 1;
+    fwrite(SPACES, 1, n, stdout);
+  }
+#ifdef __eir__
+  // The vsnprintf of the ELVM libc overruns truncated buffers.
+  g_emit_cnt += vprintf(fmt, ap);
+  if (newline)
+    EMIT_PUTC('\n');
+#else
+  char buf[512];
+  va_list va_cpy;
+  va_copy(va_cpy, ap);
+  int len = vsnprintf(buf, sizeof(buf) - 1, fmt, ap);
+  g_emit_cnt += len;
+  if (len < (int)sizeof(buf) - 1) {
+    if (newline)
+      buf[len++] = '\n';
+    fwrite(buf, 1, len, stdout);
+  } else {
+    vprintf(fmt, va_cpy);
+    if (newline)
+      EMIT_PUTC('\n');
+  }
+  va_end(va_cpy);
+#endif
+}
+
+void emit_line(const char* fmt, ...) {
+  va_list ap;
+  va_start(ap, fmt);
+  emit_vstr(fmt, ap, true);
+  va_end(ap);
 }
 
 void emit_str(const char* fmt, ...) {
-  if (fmt[0]) {
-    if (g_emit_started){
-      g_emit_cnt += g_indent;
-      for (int i = 0; i < g_indent; i++)
-        putchar(' ');
-      va_list ap;
-      va_start(ap, fmt);
-      g_emit_cnt += vprintf(fmt, ap);
-      va_end(ap);
-    } else {
-      g_emit_cnt += g_indent;
-      va_list ap;
-      va_start(ap, fmt);
-      g_emit_cnt += vsnprintf(NULL, 0, fmt, ap);
-      va_end(ap);
-    }
-  }
+  va_list ap;
+  va_start(ap, fmt);
+  emit_vstr(fmt, ap, false);
+  va_end(ap);
 }
 
 static const char* DEFAULT_REG_NAMES[7] = {
@@ -101,7 +164,7 @@ const char* value_str(Value* v) {
   if (v->type == REG) {
     return reg_names[v->reg];
   } else if (v->type == IMM) {
-    return format("%d", v->imm);
+    return scratch_format("%d", v->imm);
   } else {
     error("invalid value");
   }
@@ -144,7 +207,8 @@ const char* cmp_str(Inst* inst, const char* true_str) {
     default:
       error("oops");
   }
-  return format("%s %s %s", reg_names[inst->dst.reg], op_str, src_str(inst));
+  return scratch_format("%s %s %s",
+                        reg_names[inst->dst.reg], op_str, src_str(inst));
 }
 
 int emit_cnt() {
@@ -163,7 +227,7 @@ void emit_start() {
 void emit_1(int a) {
   g_emit_cnt++;
   if (g_emit_started)
-    putchar(a);
+    EMIT_PUTC(a);
 }
 
 void emit_2(int a, int b) {
@@ -222,15 +286,24 @@ void emit_diff(uint32_t a, uint32_t b) {
 }
 
 int CHUNKED_FUNC_SIZE = 512;
+int EMIT_JOBS = 0;
+static bool g_chunked_func_size_given;
 
-int emit_chunked_main_loop(Inst* inst,
-                           void (*emit_func_prologue)(int func_id),
-                           void (*emit_func_epilogue)(void),
-                           void (*emit_pc_change)(int pc),
-                           void (*emit_inst)(Inst* inst)) {
+void set_default_chunked_func_size(int size) {
+  if (!g_chunked_func_size_given)
+    CHUNKED_FUNC_SIZE = size;
+}
+
+// Emits the instructions from |inst| up to |end| as the chunked_main_loop
+// would, closing the last function. Returns the id of the last function.
+static int emit_chunks(Inst* inst, Inst* end,
+                       void (*emit_func_prologue)(int func_id),
+                       void (*emit_func_epilogue)(void),
+                       void (*emit_pc_change)(int pc),
+                       void (*emit_inst)(Inst* inst)) {
   int prev_pc = -1;
   int prev_func_id = -1;
-  for (; inst; inst = inst->next) {
+  for (; inst != end; inst = inst->next) {
     int func_id = inst->pc / CHUNKED_FUNC_SIZE;
     if (prev_pc != inst->pc) {
       if (prev_func_id != func_id) {
@@ -248,7 +321,97 @@ int emit_chunked_main_loop(Inst* inst,
     emit_inst(inst);
   }
   emit_func_epilogue();
-  return prev_func_id + 1;
+  return prev_func_id;
+}
+
+int emit_chunked_main_loop(Inst* inst,
+                           void (*emit_func_prologue)(int func_id),
+                           void (*emit_func_epilogue)(void),
+                           void (*emit_pc_change)(int pc),
+                           void (*emit_inst)(Inst* inst)) {
+  return emit_chunks(inst, NULL, emit_func_prologue, emit_func_epilogue,
+                     emit_pc_change, emit_inst) + 1;
+}
+
+int emit_parallel_chunked_main_loop(Inst* inst,
+                                    void (*emit_func_prologue)(int func_id),
+                                    void (*emit_func_epilogue)(void),
+                                    void (*emit_pc_change)(int pc),
+                                    void (*emit_inst)(Inst* inst)) {
+#ifndef __eir__
+  int jobs = EMIT_JOBS > 0 ? EMIT_JOBS : sysconf(_SC_NPROCESSORS_ONLN);
+  int num_insts = 0;
+  int num_funcs = 0;
+  int last_func_id = -1;
+  for (Inst* i = inst; i; i = i->next) {
+    int func_id = i->pc / CHUNKED_FUNC_SIZE;
+    if (func_id != last_func_id)
+      num_funcs++;
+    last_func_id = func_id;
+    num_insts++;
+  }
+  // Forking only pays off for large modules, unless asked for.
+  if (!EMIT_JOBS && jobs > num_insts / 4096)
+    jobs = num_insts / 4096;
+  if (jobs > num_funcs)
+    jobs = num_funcs;
+  if (jobs > 1) {
+    // Split the text at function boundaries into |jobs| ranges of about
+    // the same number of instructions. Each range is emitted by a forked
+    // process into a temporary file, as backends keep state in globals.
+    Inst** starts = calloc(jobs + 1, sizeof(Inst*));
+    FILE** outs = calloc(jobs, sizeof(FILE*));
+    pid_t* pids = calloc(jobs, sizeof(pid_t));
+    int n = 0;
+    int seen = 0;
+    int prev_func_id = -1;
+    for (Inst* i = inst; i; i = i->next, seen++) {
+      int func_id = i->pc / CHUNKED_FUNC_SIZE;
+      if (func_id != prev_func_id && n < jobs &&
+          seen >= (long)num_insts * n / jobs) {
+        starts[n++] = i;
+      }
+      prev_func_id = func_id;
+    }
+    starts[n] = NULL;
+
+    fflush(stdout);
+    for (int j = 0; j < n; j++) {
+      outs[j] = tmpfile();
+      if (!outs[j])
+        error("cannot create a temporary file");
+      pids[j] = fork();
+      if (pids[j] < 0)
+        error("fork failed");
+      if (pids[j] == 0) {
+        dup2(fileno(outs[j]), fileno(stdout));
+        emit_chunks(starts[j], starts[j + 1], emit_func_prologue,
+                    emit_func_epilogue, emit_pc_change, emit_inst);
+        fflush(stdout);
+        _exit(0);
+      }
+    }
+    for (int j = 0; j < n; j++) {
+      int status;
+      char buf[65536];
+      size_t len;
+      if (waitpid(pids[j], &status, 0) < 0 ||
+          !WIFEXITED(status) || WEXITSTATUS(status)) {
+        error("emitting chunks failed");
+      }
+      rewind(outs[j]);
+      while ((len = fread(buf, 1, sizeof(buf), outs[j])) > 0)
+        fwrite(buf, 1, len, stdout);
+      fclose(outs[j]);
+    }
+    free(starts);
+    free(outs);
+    free(pids);
+    return last_func_id + 1;
+  }
+#endif
+  return emit_chunked_main_loop(inst, emit_func_prologue, emit_func_epilogue,
+                                emit_pc_change, emit_inst);
 }
 
 #define PACK2(x) ((x) % 256), ((x) / 256)
@@ -294,6 +457,9 @@ bool parse_bool_value(const char* value) {
 bool handle_chunked_func_size_arg(const char* key, const char* value) {
   if (!strcmp(key, "chunked_func_size")) {
     CHUNKED_FUNC_SIZE = atoi(value);
+    if (CHUNKED_FUNC_SIZE <= 0)
+      error("invalid chunked_func_size: %s", value);
+    g_chunked_func_size_given = true;
     return true;
   }
   return false;
@@ -15,12 +15,20 @@ static const int ELF_HEADER_SIZE = 84;
 
 char* vformat(const char* fmt, va_list ap);
 char* format(const char* fmt, ...);
+// Like format, but without an allocation: the result lives in a ring of
+// buffers and is overwritten 64 calls later, so it is only good for the
+// instruction being emitted. Longer strings fall back to format.
+const char* scratch_format(const char* fmt, ...);
 
 #ifdef __GNUC__
 __attribute__((noreturn))
 #endif
 void error(const char* fmt, ...);
 
+// Gives stdout, which all emitters write to, a large buffer, after
+// reopening it as |path| unless |path| is NULL.
+void emit_init_output(const char* path);
+
 void inc_indent();
 void dec_indent();
 void emit_line(const char* fmt, ...);
@@ -28,6 +36,7 @@ void emit_str(const char* fmt, ...);
 
 Op normalize_cond(Op op, bool flip);
 extern const char** reg_names;
+// These return scratch_format strings.
 const char* value_str(Value* v);
 const char* src_str(Inst* inst);
 const char* cmp_str(Inst* inst, const char* true_str);
@@ -45,6 +54,12 @@ void emit_le(uint32_t a);
 void emit_diff(uint32_t a, uint32_t b);
 
 extern int CHUNKED_FUNC_SIZE;
+// For backends whose best chunk size differs from the 512 of the
+// others. Does nothing if -chunked_func_size was given.
+void set_default_chunked_func_size(int size);
+// The number of processes for emit_parallel_chunked_main_loop, or 0 for
+// one per CPU.
+extern int EMIT_JOBS;
 
 int emit_chunked_main_loop(Inst* inst,
                            void (*emit_func_prologue)(int func_id),
@@ -52,6 +67,15 @@ int emit_chunked_main_loop(Inst* inst,
                            void (*emit_pc_change)(int pc),
                            void (*emit_inst)(Inst* inst));
 
+// Like emit_chunked_main_loop, but emits ranges of functions in
+// parallel and concatenates them, for backends whose output for a
+// function does not depend on the functions before it.
+int emit_parallel_chunked_main_loop(Inst* inst,
+                                    void (*emit_func_prologue)(int func_id),
+                                    void (*emit_func_epilogue)(void),
+                                    void (*emit_pc_change)(int pc),
+                                    void (*emit_inst)(Inst* inst));
+
 void emit_elf_header(uint16_t machine, uint32_t filesz);
 
 bool parse_bool_value(const char* value);
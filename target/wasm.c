@@ -74,9 +74,9 @@ static void wasm_emit_pc_change(int pc) {
 
 static const char* wasm_get_value(Value *v) {
   if (v->type == REG) {
-    return format("(get_global $%s)", reg_names[v->reg]);
+    return scratch_format("(get_global $%s)", reg_names[v->reg]);
   } else if (v->type == IMM) {
-    return format("(i32.const %d)", v->imm);
+    return scratch_format("(i32.const %d)", v->imm);
   } else {
     error("invalid src type");
   }
@@ -101,8 +101,8 @@ static const char* wasm_cmp_expr(Inst* inst) {
     default:
       error("oops");
   }
-  return format("(%s (get_global $%s) %s)",
-                op_str, reg_names[inst->dst.reg], wasm_get_value(&inst->src));
+  return scratch_format("(%s (get_global $%s) %s)",
+                        op_str, reg_names[inst->dst.reg], wasm_get_value(&inst->src));
 }
 
 static void wasm_emit_inst(Inst* inst) {
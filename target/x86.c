@@ -83,6 +83,54 @@ static void emit_jcc(Inst* inst, int op, int* pc2addr, int rodata_addr) {
   }
 }
 
+// Extended ops which need EAX, ECX or EDX save them and get the
+// operands in EAX (dst) and ECX (src) through the stack.
+static void emit_ext_prologue(Inst* inst) {
+  // push EDX, ECX, EAX
+  emit_3(0x52, 0x51, 0x50);
+  emit_1(0x50 + REGNO[inst->dst.reg]);
+  if (inst->src.type == REG) {
+    emit_1(0x50 + REGNO[inst->src.reg]);
+  } else {
+    emit_1(0x68);
+    emit_le(inst->src.imm);
+  }
+  // pop ECX, EAX
+  emit_2(0x59, 0x58);
+}
+
+// Moves the result in EAX to dst, through the saved copy if dst is
+// one of the registers restored here.
+static void emit_ext_epilogue(Inst* inst) {
+  switch (inst->dst.reg) {
+    case A:
+      // mov [ESP], EAX
+      emit_3(0x89, 0x04, 0x24);
+      break;
+    case C:
+      // mov [ESP+4], EAX
+      emit_4(0x89, 0x44, 0x24, 0x04);
+      break;
+    case D:
+      // mov [ESP+8], EAX
+      emit_4(0x89, 0x44, 0x24, 0x08);
+      break;
+    default:
+      emit_mov_reg(inst->dst.reg, A);
+  }
+  // pop EAX, ECX, EDX
+  emit_3(0x58, 0x59, 0x5a);
+}
+
+static void emit_bitwise(Inst* inst, int op_reg, int op_imm) {
+  if (inst->src.type == REG) {
+    emit_2(op_reg, modr(inst->dst.reg, inst->src.reg));
+  } else {
+    emit_2(0x81, op_imm + REGNO[inst->dst.reg]);
+    emit_le(inst->src.imm);
+  }
+}
+
 static void init_state_x86(Data* data) {
   emit_mov_imm(B, 0);
   // mov ECX, 1<<26
@@ -239,6 +287,65 @@ static void x86_emit_inst(Inst* inst, int* pc2addr, int rodata_addr) {
       emit_setcc(inst, 0x9d);
       break;
 
+    case MUL:
+      if (inst->src.type == REG) {
+        // imul dst, src
+        emit_3(0x0f, 0xaf, modr(inst->src.reg, inst->dst.reg));
+      } else {
+        emit_2(0x69, modr(inst->dst.reg, inst->dst.reg));
+        emit_le(inst->src.imm);
+      }
+      emit_2(0x81, 0xe0 + REGNO[inst->dst.reg]);
+      emit_le(0xffffff);
+      break;
+
+    case DIV:
+    case MOD:
+      emit_ext_prologue(inst);
+      // test ECX, ECX; jz +6; xor EDX, EDX; div ECX
+      emit_4(0x85, 0xc9, 0x74, 0x06);
+      emit_4(0x31, 0xd2, 0xf7, 0xf1);
+      if (inst->op == DIV) {
+        // jmp +5; mov EAX, 0xffffff
+        emit_2(0xeb, 0x05);
+        emit_mov_imm(A, 0xffffff);
+      } else {
+        // mov EAX, EDX
+        emit_mov_reg(A, D);
+      }
+      emit_ext_epilogue(inst);
+      break;
+
+    case AND:
+      emit_bitwise(inst, 0x21, 0xe0);
+      break;
+
+    case OR:
+      emit_bitwise(inst, 0x09, 0xc8);
+      break;
+
+    case XOR:
+      emit_bitwise(inst, 0x31, 0xf0);
+      break;
+
+    case SHL:
+    case SHR:
+      emit_ext_prologue(inst);
+      // cmp ECX, 24; jb +2; xor EAX, EAX
+      emit_5(0x83, 0xf9, 0x18, 0x72, 0x02);
+      emit_2(0x31, 0xc0);
+      if (inst->op == SHL) {
+        // shl EAX, CL; and EAX, 0xffffff
+        emit_2(0xd3, 0xe0);
+        emit_1(0x25);
+        emit_le(0xffffff);
+      } else {
+        // shr EAX, CL
+        emit_2(0xd3, 0xe8);
+      }
+      emit_ext_epilogue(inst);
+      break;
+
     case JEQ:
       emit_jcc(inst, 0x75, pc2addr, rodata_addr);
       break;
@@ -276,19 +383,14 @@ void target_x86(Module* module) {
   emit_reset();
   init_state_x86(module->data);
 
-  int pc_cnt = 0;
-  for (Inst* inst = module->text; inst; inst = inst->next) {
-    pc_cnt++;
-  }
-
+  int pc_cnt = module->num_blocks;
   int* pc2addr = calloc(pc_cnt, sizeof(int));
-  int prev_pc = -1;
-  for (Inst* inst = module->text; inst; inst = inst->next) {
-    if (prev_pc != inst->pc) {
-      pc2addr[inst->pc] = emit_cnt();
+  for (int pc = 0; pc < pc_cnt; pc++) {
+    BasicBlock* bb = &module->blocks[pc];
+    pc2addr[pc] = emit_cnt();
+    for (int i = bb->start; i < bb->start + bb->len; i++) {
+      x86_emit_inst(&module->insts[i], pc2addr, 0);
     }
-    prev_pc = inst->pc;
-    x86_emit_inst(inst, pc2addr, 0);
   }
 
   int rodata_addr = ELF_TEXT_START + emit_cnt() + ELF_HEADER_SIZE;
@@ -299,8 +401,8 @@ void target_x86(Module* module) {
   emit_start();
   init_state_x86(module->data);
 
-  for (Inst* inst = module->text; inst; inst = inst->next) {
-    x86_emit_inst(inst, pc2addr, rodata_addr);
+  for (int i = 0; i < module->num_insts; i++) {
+    x86_emit_inst(&module->insts[i], pc2addr, rodata_addr);
   }
 
   for (int i = 0; i < pc_cnt; i++) {
@@ -0,0 +1,51 @@
+# An arithmetic loop for timing ADD/SUB. The iteration count is small so
+# the test stays cheap on every backend; set BM_ITER to benchmark, e.g.
+#   BM_ITER=1000000 ruby test/bm_arith.eir.rb > bm.eir && time out/eli bm.eir
+iter = (ENV['BM_ITER'] || 100).to_i
+r = Random.new(42)
+regs = %w(A B C D)
+
+puts 'jmp main'
+
+# Prints A as 6 hex digits and returns to D.
+puts 'print_hex:'
+5.downto(0) do |k|
+  puts "mov C, 48"
+  puts "hex_loop#{k}:"
+  puts "jlt hex_next#{k}, A, #{16 ** k}"
+  puts "sub A, #{16 ** k}"
+  puts "add C, 1"
+  puts "jmp hex_loop#{k}"
+  puts "hex_next#{k}:"
+  puts "jlt hex_digit#{k}, C, 58"
+  puts "add C, 7"
+  puts "hex_digit#{k}:"
+  puts "putc C"
+end
+puts 'jmp D'
+
+puts 'main:'
+regs.each_with_index{|x, i| puts "mov #{x}, #{i * 0x3fffff}"}
+puts 'mov BP, 0'
+puts 'loop:'
+64.times{
+  op = %w(add sub).sample(random: r)
+  dst = regs.sample(random: r)
+  if r.rand(2) == 0
+    puts "#{op} #{dst}, #{regs.sample(random: r)}"
+  else
+    puts "#{op} #{dst}, #{[r.rand(256), 0xfffff0 + r.rand(16), r.rand(0x1000000)].sample(random: r)}"
+  end
+}
+puts 'add BP, 1'
+puts "jlt loop, BP, #{iter}"
+
+regs.each_with_index{|x, i| puts "store #{x}, #{100 + i}"}
+regs.each_with_index{|x, i|
+  puts "load A, #{100 + i}"
+  puts "mov D, ret#{i}"
+  puts 'jmp print_hex'
+  puts "ret#{i}:"
+  puts 'putc 10'
+}
+puts 'exit'
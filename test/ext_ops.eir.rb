@@ -0,0 +1,77 @@
+def emit_print(m)
+  m.each_byte{|b|
+    puts "mov A, #{b}"
+    puts "putc A"
+  }
+end
+
+REGS = %w(A B C D BP SP)
+
+CASES = {
+  'mul' => [[3, 5], [0x123456, 0x100], [0xffffff, 0xffffff], [1234, 0]],
+  'div' => [[100, 7], [0xffffff, 3], [5, 0], [7, 9]],
+  'mod' => [[100, 7], [0xfffffe, 0x800001], [5, 0], [7, 9]],
+  'and' => [[0xf0f0f0, 0x3c3c3c], [0, 0xffffff]],
+  'or' => [[0xf0f0f0, 0x3c3c3c], [0, 0xffffff]],
+  'xor' => [[0xf0f0f0, 0x3c3c3c], [0xffffff, 0xffffff]],
+  'shl' => [[1, 23], [0x123456, 4], [5, 24], [5, 0]],
+  'shr' => [[0x800000, 23], [0x123456, 4], [5, 24], [0xffffff, 0]],
+}
+
+puts 'jmp main'
+
+# Prints A as 6 hex digits and returns to D.
+puts 'print_hex:'
+5.downto(0) do |k|
+  puts "mov C, 48"
+  puts "hex_loop#{k}:"
+  puts "jlt hex_next#{k}, A, #{16 ** k}"
+  puts "sub A, #{16 ** k}"
+  puts "add C, 1"
+  puts "jmp hex_loop#{k}"
+  puts "hex_next#{k}:"
+  puts "jlt hex_digit#{k}, C, 58"
+  puts "add C, 7"
+  puts "hex_digit#{k}:"
+  puts "putc C"
+end
+puts 'jmp D'
+
+puts 'main:'
+n = 0
+CASES.each do |op, cases|
+  emit_print(op + ":")
+  cases.each do |lhs, rhs|
+    # Alternate destination registers and immediate or register sources.
+    dst = REGS[n % 6]
+    src = REGS[(n + 1) % 6]
+    puts "mov #{dst}, #{lhs}"
+    if n.odd?
+      puts "mov #{src}, #{rhs}"
+      puts "#{op} #{dst}, #{src}"
+    else
+      puts "mov #{src}, 42"
+      puts "#{op} #{dst}, #{rhs}"
+    end
+    if src == 'A'
+      puts "mov B, A"
+      puts "mov A, #{dst}"
+    else
+      puts "mov A, #{dst}" if dst != 'A'
+      puts "mov B, #{src}"
+    end
+    puts "mov D, ret#{n}"
+    puts "jmp print_hex"
+    puts "ret#{n}:"
+    emit_print(" ")
+    # The source register must survive.
+    puts "mov A, B"
+    puts "mov D, ret_src#{n}"
+    puts "jmp print_hex"
+    puts "ret_src#{n}:"
+    emit_print(" ")
+    n += 1
+  end
+  emit_print("\n")
+end
+puts 'exit'
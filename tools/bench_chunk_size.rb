@@ -0,0 +1,132 @@
+#!/usr/bin/env ruby
+#
+# Sweeps -chunked_func_size for a backend and measures how long elc
+# takes to generate the code, how long the generated code takes to
+# compile, and how long it takes to run.
+#
+# Usage: tools/bench_chunk_size.rb [-sizes 64,128,...] [-csv out.csv]
+#                                  <target> [program.c|program.eir ...]
+#
+# Programs default to test/*.c, which are compiled to out/*.c.eir with
+# make. Each run gets the first test/<name>*.in as its input, and its
+# output is checked against out/eli. For targets without a separate
+# compile step, or whose runner script compiles by itself, the compile
+# time is 0 and compilation counts as run time.
+
+require 'fileutils'
+require 'tmpdir'
+
+sizes = [64, 128, 256, 512, 1024, 2048, 4096]
+csv = nil
+while ARGV[0] && ARGV[0].start_with?('-')
+  case ARGV.shift
+  when '-sizes'
+    sizes = ARGV.shift.split(',').map(&:to_i)
+  when '-csv'
+    csv = ARGV.shift
+  else
+    abort 'usage: tools/bench_chunk_size.rb [-sizes 64,128,...] [-csv out.csv] <target> [programs...]'
+  end
+end
+target = ARGV.shift or abort 'no target'
+programs = ARGV.empty? ? Dir.glob('test/*.c').sort : ARGV
+
+# Compile and run commands for targets whose runner script mixes both.
+# |src| is the generated code and |dir| a scratch directory.
+COMPILED = {
+  'c' => ->(src, dir) {
+    ["#{ENV['CC'] || 'cc'} -w -o #{dir}/a.out #{src}", "#{dir}/a.out"]
+  },
+  'java' => ->(src, dir) {
+    FileUtils.cp(src, "#{dir}/Main.java")
+    ["javac #{dir}/Main.java", "java -cp #{dir} Main"]
+  },
+  'rs' => ->(src, dir) {
+    ["rustc -o #{dir}/a.out #{src}", "#{dir}/a.out"]
+  },
+  'swift' => ->(src, dir) {
+    FileUtils.cp(src, "#{dir}/main.swift")
+    ["swiftc -o #{dir}/a.out #{dir}/main.swift", "#{dir}/a.out"]
+  },
+  'hs' => ->(src, dir) {
+    FileUtils.cp(src, "#{dir}/Main.hs")
+    ["ghc -o #{dir}/a.out #{dir}/Main.hs", "#{dir}/a.out"]
+  },
+  'wasm' => ->(src, dir) {
+    ["wat2wasm #{src} -o #{dir}/a.wasm",
+     "nodejs tools/run_compiled_wasm.js #{dir}/a.wasm"]
+  },
+}
+
+# Otherwise, the RUNNER the Makefile uses for the target.
+def makefile_runner(target)
+  cur = nil
+  File.readlines('Makefile').each do |line|
+    cur = $1 if line =~ /^TARGET := (\S+)/
+    return $1.strip if cur == target && line =~ /^RUNNER := (.*)/
+  end
+  abort "no RUNNER for #{target} in Makefile"
+end
+
+def timed(cmd, input = File::NULL, output = File::NULL)
+  start = Process.clock_gettime(Process::CLOCK_MONOTONIC)
+  ok = system(cmd, in: input, out: output, err: File::NULL)
+  [ok, Process.clock_gettime(Process::CLOCK_MONOTONIC) - start]
+end
+
+def eir_of(program)
+  return program if program.end_with?('.eir')
+  eir = "out/#{File.basename(program)}.eir"
+  system('make', '-s', eir) or abort "failed to build #{eir}"
+  eir
+end
+
+rows = []
+Dir.mktmpdir('bench_chunk_size') do |tmp|
+  programs.each do |program|
+    eir = eir_of(program)
+    name = File.basename(program).sub(/\..*/, '')
+    input = Dir.glob("test/#{name}*.in").sort[0] || File::NULL
+    expected = "#{tmp}/expected"
+    system("out/eli #{eir}", in: input, out: expected) or
+      abort "out/eli #{eir} failed"
+
+    sizes.each do |size|
+      dir = "#{tmp}/#{name}.#{size}"
+      FileUtils.mkdir_p(dir)
+      src = "#{dir}/#{name}.#{target}"
+      ok, gen = timed("out/elc -#{target} -chunked_func_size #{size} #{eir}",
+                      File::NULL, src)
+      abort "elc failed for #{eir}" unless ok
+      compile = 0.0
+      if COMPILED[target]
+        compile_cmd, run_cmd = COMPILED[target].(src, dir)
+        ok, compile = timed(compile_cmd)
+      else
+        run_cmd = "#{makefile_runner(target)} #{src}"
+      end
+      run = 0.0
+      actual = "#{dir}/actual"
+      ok, run = timed(run_cmd, input, actual) if ok
+      ok &&= File.read(actual, mode: 'rb') == File.read(expected, mode: 'rb')
+      rows << [size, name, File.size(src), gen, compile, run, ok]
+      FileUtils.rm_rf(dir)
+    end
+  end
+end
+
+if csv
+  File.open(csv, 'w') do |f|
+    f.puts 'size,program,bytes,gen_sec,compile_sec,run_sec,ok'
+    rows.each { |r| f.puts r.join(',') }
+  end
+end
+
+puts "#{target}: totals over #{programs.size} programs"
+puts '%6s %12s %9s %11s %9s %6s' % %w(size bytes gen_sec compile_sec run_sec fails)
+sizes.each do |size|
+  rs = rows.select { |r| r[0] == size }
+  puts '%6d %12d %9.3f %11.3f %9.3f %6d' % [
+    size, rs.sum { |r| r[2] }, rs.sum { |r| r[3] }, rs.sum { |r| r[4] },
+    rs.sum { |r| r[5] }, rs.count { |r| !r[6] }]
+end
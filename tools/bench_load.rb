@@ -0,0 +1,48 @@
+#!/usr/bin/env ruby
+#
+# Measures how EIR load time scales with the number of labels.
+#
+# Usage: tools/bench_load.rb [loader] [max_labels]
+#
+# Each generated module has N text labels, N data labels, and a jump and
+# a data reference to every one of them, so nearly all of the load time
+# goes to symbol resolution. With linear resolution, usec/label stays
+# roughly flat as N doubles.
+
+require 'tempfile'
+
+loader = ARGV[0] || 'out/dump_ir'
+max_labels = (ARGV[1] || 65536).to_i
+
+def gen_eir(n)
+  eir = []
+  eir << '.text'
+  eir << 'main:'
+  n.times do |i|
+    eir << "jmp L#{i}"
+    eir << "L#{i}:"
+    eir << "mov A, D#{i}"
+  end
+  eir << 'exit'
+  eir << '.data'
+  n.times do |i|
+    eir << "D#{i}:"
+    eir << ".long L#{i}"
+  end
+  eir * "\n" + "\n"
+end
+
+puts '%8s %10s %12s' % %w(labels sec usec/label)
+n = 1024
+while n <= max_labels
+  Tempfile.create(['bench_load', '.eir']) do |f|
+    f.write(gen_eir(n))
+    f.close
+    start = Process.clock_gettime(Process::CLOCK_MONOTONIC)
+    system(loader, f.path, out: File::NULL, err: File::NULL) or
+      raise "#{loader} failed"
+    sec = Process.clock_gettime(Process::CLOCK_MONOTONIC) - start
+    puts '%8d %10.3f %12.3f' % [n, sec, sec * 1e6 / n]
+  end
+  n *= 2
+end